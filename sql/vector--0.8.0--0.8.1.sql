@@ -0,0 +1,120 @@
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "ALTER EXTENSION vector UPDATE TO '0.8.1'" to load this file. \quit
+
+-- hnsw filter opclasses
+
+CREATE OPERATOR FAMILY integer_ops USING hnsw;
+
+CREATE OPERATOR CLASS int4_ops
+	DEFAULT FOR TYPE int4 USING hnsw FAMILY integer_ops AS
+	OPERATOR 1 < ,
+	OPERATOR 2 <= ,
+	OPERATOR 3 = ,
+	OPERATOR 4 >= ,
+	OPERATOR 5 > ;
+
+CREATE OPERATOR CLASS int8_ops
+	DEFAULT FOR TYPE int8 USING hnsw FAMILY integer_ops AS
+	OPERATOR 1 < ,
+	OPERATOR 2 <= ,
+	OPERATOR 3 = ,
+	OPERATOR 4 >= ,
+	OPERATOR 5 > ;
+
+ALTER OPERATOR FAMILY integer_ops USING hnsw ADD
+	OPERATOR 1 < (int4, int8),
+	OPERATOR 2 <= (int4, int8),
+	OPERATOR 3 = (int4, int8),
+	OPERATOR 4 >= (int4, int8),
+	OPERATOR 5 > (int4, int8),
+	OPERATOR 1 < (int8, int4),
+	OPERATOR 2 <= (int8, int4),
+	OPERATOR 3 = (int8, int4),
+	OPERATOR 4 >= (int8, int4),
+	OPERATOR 5 > (int8, int4);
+
+CREATE OPERATOR CLASS text_ops
+	DEFAULT FOR TYPE text USING hnsw AS
+	OPERATOR 1 < ,
+	OPERATOR 2 <= ,
+	OPERATOR 3 = ,
+	OPERATOR 4 >= ,
+	OPERATOR 5 > ;
+
+-- hnsw functions
+
+CREATE FUNCTION hnsw_search_batch(index regclass, queries anyarray, k integer, ef integer DEFAULT NULL,
+	OUT query_idx integer, OUT tid tid, OUT distance float8) RETURNS SETOF record
+	AS 'MODULE_PATHNAME' LANGUAGE C STABLE PARALLEL SAFE;
+
+CREATE FUNCTION hnsw_search_trace(index regclass, query anyelement, ef integer DEFAULT NULL,
+	OUT step integer, OUT layer integer, OUT tid tid, OUT distance float8,
+	OUT neighbors_scored integer, OUT neighbors_skipped integer, OUT boundary_distance float8) RETURNS SETOF record
+	AS 'MODULE_PATHNAME' LANGUAGE C STABLE PARALLEL SAFE;
+
+-- index statistics
+
+CREATE FUNCTION pg_stat_vector_indexes(OUT indexrelid oid, OUT distances int8, OUT pages_read int8,
+	OUT tuples_visited int8, OUT resumes int8, OUT cutoffs int8, OUT neighbor_updates int8, OUT lock_waits int8)
+	RETURNS SETOF record AS 'MODULE_PATHNAME' LANGUAGE C VOLATILE;
+
+CREATE FUNCTION pg_stat_vector_indexes_reset() RETURNS void
+	AS 'MODULE_PATHNAME' LANGUAGE C VOLATILE;
+
+REVOKE ALL ON FUNCTION pg_stat_vector_indexes_reset() FROM PUBLIC;
+
+CREATE VIEW pg_stat_vector_indexes AS
+	SELECT s.indexrelid, i.indrelid AS relid, c.relname AS indexrelname, a.amname,
+		s.distances, s.pages_read, s.tuples_visited, s.resumes, s.cutoffs, s.neighbor_updates, s.lock_waits
+	FROM pg_stat_vector_indexes() s
+	INNER JOIN pg_catalog.pg_class c ON c.oid = s.indexrelid
+	INNER JOIN pg_catalog.pg_index i ON i.indexrelid = s.indexrelid
+	INNER JOIN pg_catalog.pg_am a ON a.oid = c.relam;
+
+-- hnsw range operators
+
+CREATE FUNCTION hnsw_within(vector, record) RETURNS bool
+	AS 'MODULE_PATHNAME' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <@ (
+	LEFTARG = vector, RIGHTARG = record, PROCEDURE = hnsw_within
+);
+
+CREATE FUNCTION hnsw_within(halfvec, record) RETURNS bool
+	AS 'MODULE_PATHNAME' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <@ (
+	LEFTARG = halfvec, RIGHTARG = record, PROCEDURE = hnsw_within
+);
+
+CREATE FUNCTION hnsw_within(bit, record) RETURNS bool
+	AS 'MODULE_PATHNAME' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <@ (
+	LEFTARG = bit, RIGHTARG = record, PROCEDURE = hnsw_within
+);
+
+CREATE FUNCTION hnsw_within(sparsevec, record) RETURNS bool
+	AS 'MODULE_PATHNAME' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <@ (
+	LEFTARG = sparsevec, RIGHTARG = record, PROCEDURE = hnsw_within
+);
+
+ALTER OPERATOR FAMILY vector_l2_ops USING hnsw ADD OPERATOR 2 <@ (vector, record);
+ALTER OPERATOR FAMILY vector_ip_ops USING hnsw ADD OPERATOR 2 <@ (vector, record);
+ALTER OPERATOR FAMILY vector_cosine_ops USING hnsw ADD OPERATOR 2 <@ (vector, record);
+ALTER OPERATOR FAMILY vector_l1_ops USING hnsw ADD OPERATOR 2 <@ (vector, record);
+
+ALTER OPERATOR FAMILY halfvec_l2_ops USING hnsw ADD OPERATOR 2 <@ (halfvec, record);
+ALTER OPERATOR FAMILY halfvec_ip_ops USING hnsw ADD OPERATOR 2 <@ (halfvec, record);
+ALTER OPERATOR FAMILY halfvec_cosine_ops USING hnsw ADD OPERATOR 2 <@ (halfvec, record);
+ALTER OPERATOR FAMILY halfvec_l1_ops USING hnsw ADD OPERATOR 2 <@ (halfvec, record);
+
+ALTER OPERATOR FAMILY bit_hamming_ops USING hnsw ADD OPERATOR 2 <@ (bit, record);
+ALTER OPERATOR FAMILY bit_jaccard_ops USING hnsw ADD OPERATOR 2 <@ (bit, record);
+
+ALTER OPERATOR FAMILY sparsevec_l2_ops USING hnsw ADD OPERATOR 2 <@ (sparsevec, record);
+ALTER OPERATOR FAMILY sparsevec_ip_ops USING hnsw ADD OPERATOR 2 <@ (sparsevec, record);
+ALTER OPERATOR FAMILY sparsevec_cosine_ops USING hnsw ADD OPERATOR 2 <@ (sparsevec, record);
+ALTER OPERATOR FAMILY sparsevec_l1_ops USING hnsw ADD OPERATOR 2 <@ (sparsevec, record);
@@ -67,3 +67,46 @@ jaccard_distance(PG_FUNCTION_ARGS)
 
 	PG_RETURN_FLOAT8(BitJaccardDistance(VARBITBYTES(a), VARBITS(a), VARBITS(b), 0, 0, 0));
 }
+
+/*
+ * Get the Hamming distance between two bit vectors without fmgr
+ */
+static double
+BitHammingDistanceKernel(Datum ad, Datum bd)
+{
+	VarBit	   *a = DatumGetVarBitP(ad);
+	VarBit	   *b = DatumGetVarBitP(bd);
+
+	CheckDims(a, b);
+
+	return (double) BitHammingDistance(VARBITBYTES(a), VARBITS(a), VARBITS(b), 0);
+}
+
+/*
+ * Get the Jaccard distance between two bit vectors without fmgr
+ */
+static double
+BitJaccardDistanceKernel(Datum ad, Datum bd)
+{
+	VarBit	   *a = DatumGetVarBitP(ad);
+	VarBit	   *b = DatumGetVarBitP(bd);
+
+	CheckDims(a, b);
+
+	return BitJaccardDistance(VARBITBYTES(a), VARBITS(a), VARBITS(b), 0, 0, 0);
+}
+
+/*
+ * Get the kernel for a distance function, or NULL if none
+ */
+VectorDistanceKernel
+BitGetDistanceKernel(PGFunction fn)
+{
+	if (fn == hamming_distance)
+		return BitHammingDistanceKernel;
+
+	if (fn == jaccard_distance)
+		return BitJaccardDistanceKernel;
+
+	return NULL;
+}
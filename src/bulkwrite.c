@@ -0,0 +1,218 @@
+#include "postgres.h"
+
+#include "access/xloginsert.h"
+#include "access/xlogrecord.h"
+#include "bulkwrite.h"
+#include "storage/smgr.h"
+#include "utils/rel.h"
+
+#if PG_VERSION_NUM >= 170000
+#include "storage/bulk_write.h"
+#endif
+
+/*
+ * Index builds write new pages in private memory and hand them to the
+ * writer, which emits them sequentially with full-page WAL records in
+ * batches. Postgres 17+ provides this as the bulk_write API. For earlier
+ * versions, the same is done by extending the relation directly with smgr
+ * and syncing it at the end, like B-tree builds do.
+ *
+ * Blocks may be written out of order (the gap is filled with zero pages
+ * until it is written), but each block must only be written once, and the
+ * relation fork must be empty when the writer is started.
+ */
+
+#define BULK_WRITER_MAX_PENDING XLR_MAX_BLOCK_ID
+
+#if PG_VERSION_NUM >= 160000
+#define RelationGetFileLocator(r) (&(r)->rd_locator)
+#else
+#define RelationGetFileLocator(r) (&(r)->rd_node)
+#endif
+
+typedef struct PendingWrite
+{
+	BlockNumber blkno;
+	Page		page;
+}			PendingWrite;
+
+struct BulkWriter
+{
+#if PG_VERSION_NUM >= 170000
+	BulkWriteState *state;
+#else
+	Relation	index;
+	ForkNumber	forkNum;
+	bool		useWal;
+	BlockNumber pagesWritten;
+	int			npending;
+	PendingWrite pending[BULK_WRITER_MAX_PENDING];
+#endif
+};
+
+/*
+ * Start writing pages to an empty relation fork
+ */
+BulkWriter *
+BulkWriterStart(Relation index, ForkNumber forkNum)
+{
+	BulkWriter *writer = palloc0(sizeof(BulkWriter));
+
+#if PG_VERSION_NUM >= 170000
+	writer->state = smgr_bulk_start_rel(index, forkNum);
+#else
+	writer->index = index;
+	writer->forkNum = forkNum;
+	writer->useWal = RelationNeedsWAL(index) || forkNum == INIT_FORKNUM;
+	writer->pagesWritten = 0;
+	writer->npending = 0;
+#endif
+
+	return writer;
+}
+
+/*
+ * Get a page to fill in, which is owned by the writer once written
+ */
+Page
+BulkWriterGetPage(BulkWriter * writer)
+{
+#if PG_VERSION_NUM >= 170000
+	return (Page) smgr_bulk_get_buf(writer->state);
+#elif PG_VERSION_NUM >= 160000
+	return (Page) palloc_aligned(BLCKSZ, PG_IO_ALIGN_SIZE, 0);
+#else
+	return (Page) palloc(BLCKSZ);
+#endif
+}
+
+#if PG_VERSION_NUM < 170000
+/*
+ * Compare block numbers of pending writes
+ */
+static int
+ComparePendingWrites(const void *a, const void *b)
+{
+	BlockNumber blkno1 = ((const PendingWrite *) a)->blkno;
+	BlockNumber blkno2 = ((const PendingWrite *) b)->blkno;
+
+	if (blkno1 < blkno2)
+		return -1;
+
+	if (blkno1 > blkno2)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * WAL-log and write pending pages
+ */
+static void
+BulkWriterFlush(BulkWriter * writer)
+{
+	Relation	index = writer->index;
+	ForkNumber	forkNum = writer->forkNum;
+	int			npending = writer->npending;
+	PendingWrite *pending = writer->pending;
+	Page		zeroPage = NULL;
+
+	if (npending == 0)
+		return;
+
+	qsort(pending, npending, sizeof(PendingWrite), ComparePendingWrites);
+
+	if (writer->useWal)
+	{
+#if PG_VERSION_NUM >= 140000
+		BlockNumber blknos[BULK_WRITER_MAX_PENDING];
+		Page		pages[BULK_WRITER_MAX_PENDING];
+
+		for (int i = 0; i < npending; i++)
+		{
+			blknos[i] = pending[i].blkno;
+			pages[i] = pending[i].page;
+		}
+
+		log_newpages(RelationGetFileLocator(index), forkNum, npending, blknos, pages, true);
+#else
+		for (int i = 0; i < npending; i++)
+			log_newpage(RelationGetFileLocator(index), forkNum, pending[i].blkno, pending[i].page, true);
+#endif
+	}
+
+	for (int i = 0; i < npending; i++)
+	{
+		BlockNumber blkno = pending[i].blkno;
+		Page		page = pending[i].page;
+
+		PageSetChecksumInplace(page, blkno);
+
+		if (blkno >= writer->pagesWritten)
+		{
+			/* Fill the gap with zero pages until they are written */
+			while (blkno > writer->pagesWritten)
+			{
+				if (zeroPage == NULL)
+					zeroPage = palloc0(BLCKSZ);
+
+				smgrextend(RelationGetSmgr(index), forkNum, writer->pagesWritten++, (char *) zeroPage, true);
+			}
+
+			smgrextend(RelationGetSmgr(index), forkNum, blkno, (char *) page, true);
+			writer->pagesWritten = blkno + 1;
+		}
+		else
+			smgrwrite(RelationGetSmgr(index), forkNum, blkno, (char *) page, true);
+
+		pfree(page);
+	}
+
+	if (zeroPage != NULL)
+		pfree(zeroPage);
+
+	writer->npending = 0;
+}
+#endif
+
+/*
+ * Write a page
+ */
+void
+BulkWriterWrite(BulkWriter * writer, BlockNumber blkno, Page page)
+{
+#if PG_VERSION_NUM >= 170000
+	smgr_bulk_write(writer->state, blkno, (BulkWriteBuffer) page, true);
+#else
+	if (writer->npending == BULK_WRITER_MAX_PENDING)
+		BulkWriterFlush(writer);
+
+	writer->pending[writer->npending].blkno = blkno;
+	writer->pending[writer->npending].page = page;
+	writer->npending++;
+#endif
+}
+
+/*
+ * Write the remaining pages and sync the relation fork if needed
+ */
+void
+BulkWriterFinish(BulkWriter * writer)
+{
+#if PG_VERSION_NUM >= 170000
+	smgr_bulk_finish(writer->state);
+#else
+	BulkWriterFlush(writer);
+
+	/*
+	 * The pages were written outside of shared buffers, so a checkpoint
+	 * during the build did not flush them, and WAL before its redo pointer
+	 * would not be replayed after a crash. Relations that skip WAL are
+	 * synced at commit instead.
+	 */
+	if (writer->useWal)
+		smgrimmedsync(RelationGetSmgr(writer->index), writer->forkNum);
+#endif
+
+	pfree(writer);
+}
@@ -0,0 +1,19 @@
+#ifndef BULKWRITE_H
+#define BULKWRITE_H
+
+#include "postgres.h"
+
+#include "common/relpath.h"
+#include "storage/block.h"
+#include "storage/bufpage.h"
+#include "utils/relcache.h"
+
+/* Writes new pages of an index build without going through shared buffers */
+typedef struct BulkWriter BulkWriter;
+
+BulkWriter *BulkWriterStart(Relation index, ForkNumber forkNum);
+Page		BulkWriterGetPage(BulkWriter * writer);
+void		BulkWriterWrite(BulkWriter * writer, BlockNumber blkno, Page page);
+void		BulkWriterFinish(BulkWriter * writer);
+
+#endif
@@ -670,6 +670,66 @@ halfvec_l1_distance(PG_FUNCTION_ARGS)
 	PG_RETURN_FLOAT8((double) HalfvecL1Distance(a->dim, a->x, b->x));
 }
 
+/*
+ * Get the L2 squared distance between half vectors without fmgr
+ */
+static double
+HalfvecL2SquaredDistanceKernel(Datum ad, Datum bd)
+{
+	HalfVector *a = DatumGetHalfVector(ad);
+	HalfVector *b = DatumGetHalfVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) HalfvecL2SquaredDistance(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the negative inner product of two half vectors without fmgr
+ */
+static double
+HalfvecNegativeInnerProductKernel(Datum ad, Datum bd)
+{
+	HalfVector *a = DatumGetHalfVector(ad);
+	HalfVector *b = DatumGetHalfVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) -HalfvecInnerProduct(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the L1 distance between two half vectors without fmgr
+ */
+static double
+HalfvecL1DistanceKernel(Datum ad, Datum bd)
+{
+	HalfVector *a = DatumGetHalfVector(ad);
+	HalfVector *b = DatumGetHalfVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) HalfvecL1Distance(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the kernel for a distance function, or NULL if none
+ */
+VectorDistanceKernel
+HalfvecGetDistanceKernel(PGFunction fn)
+{
+	if (fn == halfvec_l2_squared_distance)
+		return HalfvecL2SquaredDistanceKernel;
+
+	if (fn == halfvec_negative_inner_product)
+		return HalfvecNegativeInnerProductKernel;
+
+	if (fn == halfvec_l1_distance)
+		return HalfvecL1DistanceKernel;
+
+	return NULL;
+}
+
 /*
  * Get the dimensions of a half vector
  */
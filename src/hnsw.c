@@ -11,6 +11,7 @@
 #include "miscadmin.h"
 #include "utils/float.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/selfuncs.h"
 #include "utils/spccache.h"
 
@@ -29,9 +30,22 @@ int			hnsw_ef_search;
 int			hnsw_iterative_scan;
 int			hnsw_max_scan_tuples;
 double		hnsw_scan_mem_multiplier;
+double		hnsw_ef_search_factor;
+int			hnsw_search_patience;
+int			hnsw_prefetch_depth;
+int			hnsw_upper_cache_size;
+int			hnsw_shared_cache_size;
+bool		hnsw_partitioned_build;
+bool		hnsw_reorder_build;
 int			hnsw_lock_tranche_id;
 static relopt_kind hnsw_relopt_kind;
 
+static relopt_enum_elt_def hnsw_quantization_options[] = {
+	{"none", HNSW_QUANTIZATION_NONE},
+	{"sq8", HNSW_QUANTIZATION_SQ8},
+	{(const char *) NULL}
+};
+
 /*
  * Assign a tranche ID for our LWLocks. This only needs to be done by one
  * backend, as the tranche ID is remembered in shared memory.
@@ -74,17 +88,27 @@ HnswInit(void)
 					  HNSW_DEFAULT_M, HNSW_MIN_M, HNSW_MAX_M, AccessExclusiveLock);
 	add_int_reloption(hnsw_relopt_kind, "ef_construction", "Size of the dynamic candidate list for construction",
 					  HNSW_DEFAULT_EF_CONSTRUCTION, HNSW_MIN_EF_CONSTRUCTION, HNSW_MAX_EF_CONSTRUCTION, AccessExclusiveLock);
+	add_enum_reloption(hnsw_relopt_kind, "quantization", "Type of quantization for stored vectors",
+					   hnsw_quantization_options, HNSW_QUANTIZATION_NONE, "Valid values are \"none\" and \"sq8\".", AccessExclusiveLock);
 
 	DefineCustomIntVariable("hnsw.ef_search", "Sets the size of the dynamic candidate list for search",
 							"Valid range is 1..1000.", &hnsw_ef_search,
 							HNSW_DEFAULT_EF_SEARCH, HNSW_MIN_EF_SEARCH, HNSW_MAX_EF_SEARCH, PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomRealVariable("hnsw.ef_search_factor", "Sets ef_search as a multiple of LIMIT for queries with a constant LIMIT",
+							 "Zero disables. Replaces hnsw.ef_search, with the LIMIT as the minimum.", &hnsw_ef_search_factor,
+							 0, 0, HNSW_MAX_EF_SEARCH, PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hnsw.search_patience", "Sets the number of expansions without better results before a scan stops",
+							"Zero disables.", &hnsw_search_patience,
+							0, 0, INT_MAX, PGC_USERSET, 0, NULL, NULL, NULL);
+
 	DefineCustomEnumVariable("hnsw.iterative_scan", "Sets the mode for iterative scans",
 							 NULL, &hnsw_iterative_scan,
 							 HNSW_ITERATIVE_SCAN_OFF, hnsw_iterative_scan_options, PGC_USERSET, 0, NULL, NULL, NULL);
 
-	/* This is approximate and does not affect the initial scan */
-	DefineCustomIntVariable("hnsw.max_scan_tuples", "Sets the max number of tuples to visit for iterative scans",
+	/* This is approximate and applies to iterative scans and the initial scan with filter columns */
+	DefineCustomIntVariable("hnsw.max_scan_tuples", "Sets the max number of tuples to visit for iterative scans and scans with filter columns",
 							NULL, &hnsw_max_scan_tuples,
 							20000, 1, INT_MAX, PGC_USERSET, 0, NULL, NULL, NULL);
 
@@ -93,7 +117,31 @@ HnswInit(void)
 							 NULL, &hnsw_scan_mem_multiplier,
 							 1, 1, 1000, PGC_USERSET, 0, NULL, NULL, NULL);
 
+	DefineCustomIntVariable("hnsw.prefetch_depth", "Sets the max number of neighbor pages to prefetch for each candidate",
+							"Zero disables prefetching.", &hnsw_prefetch_depth,
+							0, 0, HNSW_MAX_M * 2, PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hnsw.upper_cache_size", "Sets the max memory to cache upper layers for scans in each backend",
+							"Zero disables the cache.", &hnsw_upper_cache_size,
+							0, 0, MaxAllocSize / 1024, PGC_USERSET, GUC_UNIT_KB, NULL, NULL, NULL);
+
+	DefineCustomIntVariable("hnsw.shared_cache_size", "Sets the shared memory to cache neighbor lists for scans across backends",
+							"Zero disables the cache. Requires shared_preload_libraries.", &hnsw_shared_cache_size,
+							0, 0, MAX_KILOBYTES, PGC_POSTMASTER, GUC_UNIT_KB, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("hnsw.partitioned_build", "Builds the graph in partitions when it no longer fits into maintenance_work_mem",
+							 "Otherwise, remaining tuples are inserted into the graph on disk.", &hnsw_partitioned_build,
+							 false, PGC_USERSET, 0, NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("hnsw.reorder_build", "Orders elements by graph traversal when writing the graph during index builds",
+							 "This places neighbors on the same or nearby pages.", &hnsw_reorder_build,
+							 false, PGC_USERSET, 0, NULL, NULL, NULL);
+
 	MarkGUCPrefixReserved("hnsw");
+
+	HnswInitSharedCache();
+	HnswInitExecutorHook();
+	HnswInitPlannerHook();
 }
 
 /*
@@ -108,6 +156,8 @@ hnswbuildphasename(int64 phasenum)
 			return "initializing";
 		case PROGRESS_HNSW_PHASE_LOAD:
 			return "loading tuples";
+		case PROGRESS_HNSW_PHASE_REFINE:
+			return "refining partitions";
 		default:
 			return NULL;
 	}
@@ -149,7 +199,7 @@ hnswcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	genericcostestimate(root, path, loop_count, &costs);
 
 	index = index_open(path->indexinfo->indexoid, NoLock);
-	HnswGetMetaPageInfo(index, &m, NULL);
+	HnswGetMetaPageInfo(index, &m, NULL, NULL, NULL);
 	index_close(index, NoLock);
 
 	/*
@@ -226,6 +276,7 @@ hnswoptions(Datum reloptions, bool validate)
 	static const relopt_parse_elt tab[] = {
 		{"m", RELOPT_TYPE_INT, offsetof(HnswOptions, m)},
 		{"ef_construction", RELOPT_TYPE_INT, offsetof(HnswOptions, efConstruction)},
+		{"quantization", RELOPT_TYPE_ENUM, offsetof(HnswOptions, quantization)},
 	};
 
 	return (bytea *) build_reloptions(reloptions, validate,
@@ -261,7 +312,7 @@ hnswhandler(PG_FUNCTION_ARGS)
 	amroutine->amcanorderbyop = true;
 	amroutine->amcanbackward = false;	/* can change direction mid-scan */
 	amroutine->amcanunique = false;
-	amroutine->amcanmulticol = false;
+	amroutine->amcanmulticol = true;
 	amroutine->amoptionalkey = true;
 	amroutine->amsearcharray = false;
 	amroutine->amsearchnulls = false;
@@ -272,7 +323,7 @@ hnswhandler(PG_FUNCTION_ARGS)
 #if PG_VERSION_NUM >= 170000
 	amroutine->amcanbuildparallel = true;
 #endif
-	amroutine->amcaninclude = false;
+	amroutine->amcaninclude = true;
 	amroutine->amusemaintenanceworkmem = false; /* not used during VACUUM */
 #if PG_VERSION_NUM >= 160000
 	amroutine->amsummarizing = false;
@@ -289,7 +340,7 @@ hnswhandler(PG_FUNCTION_ARGS)
 #endif
 	amroutine->ambulkdelete = hnswbulkdelete;
 	amroutine->amvacuumcleanup = hnswvacuumcleanup;
-	amroutine->amcanreturn = NULL;
+	amroutine->amcanreturn = hnswcanreturn;
 	amroutine->amcostestimate = hnswcostestimate;
 	amroutine->amoptions = hnswoptions;
 	amroutine->amproperty = NULL;	/* TODO AMPROP_DISTANCE_ORDERABLE */
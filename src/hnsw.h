@@ -4,10 +4,14 @@
 #include "postgres.h"
 
 #include "access/genam.h"
+#include "access/itup.h"
 #include "access/parallel.h"
+#include "access/xlogdefs.h"
+#include "indexstats.h"
 #include "lib/pairingheap.h"
 #include "nodes/execnodes.h"
 #include "port.h"				/* for random() */
+#include "port/atomics.h"
 #include "utils/relptr.h"
 #include "utils/sampling.h"
 #include "vector.h"
@@ -20,6 +24,9 @@
 #define HNSW_NORM_PROC 2
 #define HNSW_TYPE_INFO_PROC 3
 
+/* Strategy for ranges of the ORDER BY operator, after ORDER BY */
+#define HNSW_RANGE_STRATEGY 2
+
 #define HNSW_VERSION	1
 #define HNSW_MAGIC_NUMBER 0xA953A953
 #define HNSW_PAGE_ID	0xFF90
@@ -43,10 +50,18 @@
 #define HNSW_MIN_EF_SEARCH		1
 #define HNSW_MAX_EF_SEARCH		1000
 
+/* Quantization types */
+#define HNSW_QUANTIZATION_NONE	0
+#define HNSW_QUANTIZATION_SQ8	1
+
 /* Tuple types */
 #define HNSW_ELEMENT_TUPLE_TYPE  1
 #define HNSW_NEIGHBOR_TUPLE_TYPE 2
 
+/* Element tuple flags */
+#define HNSW_ELEMENT_SQ8 0x0001
+#define HNSW_ELEMENT_ATTRS 0x0002
+
 /* Make graph robust against non-HOT updates */
 #define HNSW_HEAPTIDS 10
 
@@ -56,23 +71,36 @@
 /* Build phases */
 /* PROGRESS_CREATEIDX_SUBPHASE_INITIALIZE is 1 */
 #define PROGRESS_HNSW_PHASE_LOAD		2
+#define PROGRESS_HNSW_PHASE_REFINE		3
 
 #define HNSW_MAX_SIZE (BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(HnswPageOpaqueData)) - sizeof(ItemIdData))
 #define HNSW_TUPLE_ALLOC_SIZE BLCKSZ
 
 #define HNSW_ELEMENT_TUPLE_SIZE(size)	MAXALIGN(offsetof(HnswElementTupleData, data) + (size))
+#define HNSW_SQ8_SIZE(_dim)	(offsetof(HnswSq8Vector, x) + sizeof(uint8)*(_dim))
 #define HNSW_NEIGHBOR_TUPLE_SIZE(level, m)	MAXALIGN(offsetof(HnswNeighborTupleData, indextids) + ((level) + 2) * (m) * sizeof(ItemPointerData))
 
+/* Shared memory reserved at once by each process in parallel builds */
+#define HNSW_BUILD_CHUNK_SIZE	(64 * 1024)
+
+/* Number of distances calculated at once when pruning neighbors */
+#define HNSW_DISTANCE_BATCH_SIZE	8
+
 #define HNSW_NEIGHBOR_ARRAY_SIZE(lm)	(offsetof(HnswNeighborArray, items) + sizeof(HnswCandidate) * (lm))
 
 #define HnswPageGetOpaque(page)	((HnswPageOpaque) PageGetSpecialPointer(page))
 #define HnswPageGetMeta(page)	((HnswMetaPageData *) PageGetContents(page))
 
+/* End of the metapage data, which is shorter for indexes created before 0.8.1 */
+#define HnswMetaPageLower(page)	((uint16) (((char *) HnswPageGetMeta(page) + sizeof(HnswMetaPageData)) - (char *) (page)))
+
 #if PG_VERSION_NUM >= 150000
 #define RandomDouble() pg_prng_double(&pg_global_prng_state)
+#define RandomInt() pg_prng_uint32(&pg_global_prng_state)
 #define SeedRandom(seed) pg_prng_seed(&pg_global_prng_state, seed)
 #else
 #define RandomDouble() (((double) random()) / MAX_RANDOM_VALUE)
+#define RandomInt() random()
 #define SeedRandom(seed) srandom(seed)
 #endif
 
@@ -93,6 +121,11 @@
 
 #define HnswGetValue(base, element) PointerGetDatum(HnswPtrAccess(base, (element)->value))
 
+/* Columns after the first are stored as an index tuple following the value */
+#define HnswHasAttrs(index) (IndexRelationGetNumberOfAttributes(index) > 1)
+#define HnswValueAttrs(value) ((IndexTuple) ((char *) (value) + MAXALIGN(VARSIZE_ANY(value))))
+#define HnswElementTupleAttrs(etup) HnswValueAttrs(&(etup)->data)
+
 #if PG_VERSION_NUM < 140005
 #define relptr_offset(rp) ((rp).relptr_off - 1)
 #endif
@@ -112,6 +145,13 @@ extern int	hnsw_ef_search;
 extern int	hnsw_iterative_scan;
 extern int	hnsw_max_scan_tuples;
 extern double hnsw_scan_mem_multiplier;
+extern double hnsw_ef_search_factor;
+extern int	hnsw_search_patience;
+extern int	hnsw_prefetch_depth;
+extern int	hnsw_upper_cache_size;
+extern int	hnsw_shared_cache_size;
+extern bool hnsw_partitioned_build;
+extern bool hnsw_reorder_build;
 extern int	hnsw_lock_tranche_id;
 
 typedef enum HnswIterativeScanMode
@@ -121,6 +161,14 @@ typedef enum HnswIterativeScanMode
 	HNSW_ITERATIVE_SCAN_STRICT
 }			HnswIterativeScanMode;
 
+/* How index distances relate to distances of the ORDER BY operator */
+typedef enum HnswDistanceType
+{
+	HNSW_DISTANCE_SAME,
+	HNSW_DISTANCE_SQUARED,
+	HNSW_DISTANCE_COSINE
+}			HnswDistanceType;
+
 typedef struct HnswElementData HnswElementData;
 typedef struct HnswNeighborArray HnswNeighborArray;
 
@@ -143,12 +191,13 @@ struct HnswElementData
 	uint8		level;
 	uint8		deleted;
 	uint8		version;
-	uint32		hash;
+	uint32		id;
 	HnswNeighborsPtr neighbors;
 	BlockNumber blkno;
 	OffsetNumber offno;
 	OffsetNumber neighborOffno;
 	BlockNumber neighborPage;
+	float		sq8Error;		/* per-dimension error of 8-bit codes */
 	DatumPtr	value;
 	LWLock		lock;
 };
@@ -171,18 +220,38 @@ struct HnswNeighborArray
 
 typedef struct HnswSearchCandidate
 {
-	pairingheap_node c_node;
 	pairingheap_node w_node;
 	HnswElementPtr element;
 	double		distance;
+
+	/* Location when discarded without loading the element */
+	BlockNumber blkno;
+	OffsetNumber offno;
+	uint8		version;
 }			HnswSearchCandidate;
 
+typedef struct HnswQueueItem
+{
+	HnswElementPtr element;
+	double		distance;
+}			HnswQueueItem;
+
+/* Array-backed binary heap of candidates */
+typedef struct HnswQueue
+{
+	HnswQueueItem *items;
+	int			length;
+	int			capacity;
+	bool		furthestFirst;
+}			HnswQueue;
+
 /* HNSW index options */
 typedef struct HnswOptions
 {
 	int32		vl_len_;		/* varlena header (do not touch directly!) */
 	int			m;				/* number of connections */
 	int			efConstruction; /* size of dynamic candidate list */
+	int			quantization;	/* type of quantization for stored vectors */
 }			HnswOptions;
 
 typedef struct HnswGraph
@@ -195,16 +264,23 @@ typedef struct HnswGraph
 	/* Entry state */
 	LWLock		entryLock;
 	LWLock		entryWaitLock;
+	pg_atomic_uint32 entryWaiters;
 	HnswElementPtr entryPoint;
 
 	/* Allocations state */
 	LWLock		allocatorLock;
 	Size		memoryUsed;
 	Size		memoryTotal;
+	pg_atomic_uint32 elementCount;
 
 	/* Flushed state */
 	LWLock		flushLock;
 	bool		flushed;
+
+	/* Partitions written to pages */
+	int			partitions;
+	BlockNumber insertPage;
+	ItemPointerData partitionStart;
 }			HnswGraph;
 
 typedef struct HnswShared
@@ -217,6 +293,9 @@ typedef struct HnswShared
 	/* Worker progress */
 	ConditionVariable workersdonecv;
 
+	/* Signaled once the last partition is written */
+	ConditionVariable refinecv;
+
 	/* Mutex for mutable state */
 	slock_t		mutex;
 
@@ -224,6 +303,12 @@ typedef struct HnswShared
 	int			nparticipantsdone;
 	double		reltuples;
 	HnswGraph	graphData;
+
+	/* Blocks of later partitions, claimed one at a time */
+	bool		refineReady;
+	BlockNumber refineNextBlock;
+	BlockNumber refineEndBlock;
+	int			nworkersrefined;
 }			HnswShared;
 
 #define ParallelTableScanFromHnswShared(shared) \
@@ -249,6 +334,9 @@ typedef struct HnswTypeInfo
 	int			maxDimensions;
 	Datum		(*normalize) (PG_FUNCTION_ARGS);
 	void		(*checkValue) (Pointer v);
+	VectorDistanceKernel (*getDistanceKernel) (PGFunction fn);
+	VectorDistanceBatchKernel (*getDistanceBatchKernel) (PGFunction fn);
+	bool		supportsSq8;
 }			HnswTypeInfo;
 
 typedef struct HnswSupport
@@ -256,13 +344,58 @@ typedef struct HnswSupport
 	FmgrInfo   *procinfo;
 	FmgrInfo   *normprocinfo;
 	Oid			collation;
+	VectorDistanceKernel kernel;
+	VectorDistanceBatchKernel batchKernel;
+	VectorDistanceKernel sq8Kernel;
 }			HnswSupport;
 
+/* Expansion of a candidate, reported by hnsw_search_trace */
+typedef struct HnswSearchStep
+{
+	int			layer;
+	BlockNumber blkno;
+	OffsetNumber offno;
+	double		distance;
+	int			scored;
+	int			skipped;
+	double		boundary;
+}			HnswSearchStep;
+
+typedef void (*HnswSearchTraceCallback) (HnswSearchStep * step, void *arg);
+
 typedef struct HnswQuery
 {
 	Datum		value;
+
+	/* Filter on other columns */
+	TupleDesc	tupdesc;
+	ScanKey		keys;
+	int			nkeys;
+
+	/* Metapage cache versions for scans */
+	uint32		cacheVersion;
+	uint32		upperVersion;
+	bool		sharedCache;	/* false if the metapage has no cache versions */
+
+	/* Max index distance for scans */
+	double		maxDistance;
+
+	/* Number of rows wanted by scans, or zero if unknown */
+	int			limit;
+
+	/* Called after each expansion for scans if set */
+	HnswSearchTraceCallback trace;
+	void	   *traceArg;
 }			HnswQuery;
 
+/* Visited elements for in-memory builds, indexed by element id */
+typedef struct HnswVisitedArray
+{
+	uint32	   *generations;
+	uint32		length;
+	uint32		generation;
+}			HnswVisitedArray;
+
 typedef struct HnswBuildState
 {
 	/* Info */
@@ -276,11 +409,16 @@ typedef struct HnswBuildState
 	int			dimensions;
 	int			m;
 	int			efConstruction;
+	bool		sq8;
+	bool		attrs;
 
 	/* Statistics */
 	double		indtuples;
 	double		reltuples;
 
+	/* Pages were written and WAL-logged by a bulk writer */
+	bool		bulkWritten;
+
 	/* Support functions */
 	HnswSupport support;
 
@@ -294,6 +432,12 @@ typedef struct HnswBuildState
 	MemoryContext graphCtx;
 	MemoryContext tmpCtx;
 	HnswAllocator allocator;
+	HnswVisitedArray visited;
+
+	/* Shared memory reserved by this process for parallel builds */
+	char	   *chunk;
+	Size		chunkFree;
+	int			chunkPartition;
 
 	/* Parallel builds */
 	HnswLeader *hnswleader;
@@ -312,6 +456,10 @@ typedef struct HnswMetaPageData
 	OffsetNumber entryOffno;
 	int16		entryLevel;
 	BlockNumber insertPage;
+	uint32		cacheVersion;	/* incremented when cached graph data becomes
+								 * invalid */
+	uint32		upperVersion;	/* incremented when inserts change upper
+								 * layers */
 }			HnswMetaPageData;
 
 typedef HnswMetaPageData * HnswMetaPage;
@@ -333,12 +481,23 @@ typedef struct HnswElementTupleData
 	uint8		version;
 	ItemPointerData heaptids[HNSW_HEAPTIDS];
 	ItemPointerData neighbortid;
-	uint16		unused;
+	uint16		flags;
 	Vector		data;
 }			HnswElementTupleData;
 
 typedef HnswElementTupleData * HnswElementTuple;
 
+/* Vector stored as 8-bit codes, where x = min + scale * code */
+typedef struct HnswSq8Vector
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int16		dim;			/* number of dimensions */
+	int16		unused;			/* reserved for future use, always zero */
+	float		min;
+	float		scale;
+	uint8		x[FLEXIBLE_ARRAY_MEMBER];
+}			HnswSq8Vector;
+
 typedef struct HnswNeighborTupleData
 {
 	uint8		type;
@@ -351,8 +510,7 @@ typedef HnswNeighborTupleData * HnswNeighborTuple;
 
 typedef union
 {
-	struct pointerhash_hash *pointers;
-	struct offsethash_hash *offsets;
+	HnswVisitedArray *array;
 	struct tidhash_hash *tids;
 }			visited_hash;
 
@@ -372,10 +530,31 @@ typedef struct HnswScanOpaqueData
 	HnswQuery	q;
 	int			m;
 	int64		tuples;
+	int64		limit;
+	double		radius;
+	bool		cutoff;
 	double		previousDistance;
 	Size		maxMemory;
 	MemoryContext tmpCtx;
 
+	/* Flushed at the end of the scan */
+	IndexStatsCounts counts;
+
+	/* Keys on other columns, without range keys */
+	ScanKey		keys;
+	int			nkeys;
+
+	/* Converts the radius to index distances */
+	HnswDistanceType distanceType;
+
+	/* Distances to 8-bit codes are lower bounds rechecked by the executor */
+	bool		sq8;
+	double		sq8Factor;
+
+	/* Index-only scans */
+	bool		returnValue;
+	MemoryContext tupleCtx;
+
 	/* Support functions */
 	HnswSupport support;
 }			HnswScanOpaqueData;
@@ -413,19 +592,24 @@ int			HnswGetEfConstruction(Relation index);
 FmgrInfo   *HnswOptionalProcInfo(Relation index, uint16 procnum);
 void		HnswInitSupport(HnswSupport * support, Relation index);
 Datum		HnswNormValue(const HnswTypeInfo * typeInfo, Oid collation, Datum value);
+HnswDistanceType HnswGetDistanceType(HnswSupport * support);
+double		HnswGetIndexDistance(HnswDistanceType type, double distance);
+double		HnswGetOrderByDistance(HnswDistanceType type, double distance);
+double		HnswGetDistanceEpsilon(HnswSupport * support, HnswDistanceType type, int dimensions, double distance);
 bool		HnswCheckNorm(HnswSupport * support, Datum value);
 Buffer		HnswNewBuffer(Relation index, ForkNumber forkNum);
 void		HnswInitPage(Buffer buf, Page page);
 void		HnswInit(void);
 List	   *HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation index, HnswSupport * support, int m, bool inserting, HnswElement skipElement, visited_hash * v, pairingheap **discarded, bool initVisited, int64 *tuples);
 HnswElement HnswGetEntryPoint(Relation index);
-void		HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint);
+bool		HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint, uint32 *cacheVersion, uint32 *upperVersion);
 void	   *HnswAlloc(HnswAllocator * allocator, Size size);
 HnswElement HnswInitElement(char *base, ItemPointer tid, int m, double ml, int maxLevel, HnswAllocator * alloc);
 HnswElement HnswInitElementFromBlock(BlockNumber blkno, OffsetNumber offno);
-void		HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint, Relation index, HnswSupport * support, int m, int efConstruction, bool existing);
+void		HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint, Relation index, HnswSupport * support, int m, int efConstruction, bool existing, HnswVisitedArray * visited);
 HnswSearchCandidate *HnswEntryCandidate(char *base, HnswElement em, HnswQuery * q, Relation rel, HnswSupport * support, bool loadVec);
 void		HnswUpdateMetaPage(Relation index, int updateEntry, HnswElement entryPoint, BlockNumber insertPage, ForkNumber forkNum, bool building);
+void		HnswUpdateMetaPageInfo(Page page, int updateEntry, HnswElement entryPoint, BlockNumber insertPage);
 void		HnswSetNeighborTuple(char *base, HnswNeighborTuple ntup, HnswElement e, int m);
 void		HnswAddHeapTid(HnswElement element, ItemPointer heaptid);
 HnswNeighborArray *HnswInitNeighborArray(int lm, HnswAllocator * allocator);
@@ -435,10 +619,26 @@ void		HnswUpdateNeighborsOnDisk(Relation index, HnswSupport * support, HnswEleme
 void		HnswLoadElementFromTuple(HnswElement element, HnswElementTuple etup, bool loadHeaptids, bool loadVec);
 void		HnswLoadElement(HnswElement element, double *distance, HnswQuery * q, Relation index, HnswSupport * support, bool loadVec, double *maxDistance);
 bool		HnswFormIndexValue(Datum *out, Datum *values, bool *isnull, const HnswTypeInfo * typeInfo, HnswSupport * support);
-void		HnswSetElementTuple(char *base, HnswElementTuple etup, HnswElement element);
+Datum		HnswAppendAttrs(Relation index, Datum value, Datum *values, bool *isnull);
+bool		HnswAttrsEqual(Datum a, Datum b);
+void		HnswSetElementTuple(char *base, HnswElementTuple etup, HnswElement element, bool sq8, bool attrs);
+Size		HnswElementDataSize(Pointer value, bool sq8, bool attrs);
+bool		HnswUseSq8(Relation index);
+double		HnswGetSq8ErrorFactor(HnswSupport * support, Datum q);
+double		HnswGetSq8LowerBound(HnswSupport * support, Datum q, double factor, double distance, float error);
 void		HnswUpdateConnection(char *base, HnswNeighborArray * neighbors, HnswElement newElement, float distance, int lm, int *updateIdx, Relation index, HnswSupport * support);
-bool		HnswLoadNeighborTids(HnswElement element, ItemPointerData *indextids, Relation index, int m, int lm, int lc);
+bool		HnswLoadNeighborTids(HnswElement element, ItemPointerData *indextids, Relation index, int m, int lm, int lc, uint32 *cacheVersion);
 void		HnswInitLockTranche(void);
+HnswElement HnswSearchUpperCache(Relation index, HnswQuery * q, HnswSupport * support, int m, HnswElement entryPoint, int *level);
+void		HnswInvalidateCache(Relation index);
+void		HnswUpgradeMetaPage(Page page);
+void		HnswInvalidateUpperCache(Relation index);
+void		HnswInitSharedCache(void);
+void		HnswInitExecutorHook(void);
+void		HnswInitPlannerHook(void);
+bool		HnswSharedCacheGet(Relation index, HnswElement element, int lc, uint32 cacheVersion, ItemPointerData *indextids, int lm);
+void		HnswSharedCachePut(Relation index, HnswElement element, int lc, uint32 cacheVersion, ItemPointerData *indextids, int lm, XLogRecPtr lsn);
+void		HnswSharedCacheInvalidate(Relation index, HnswElement element, int lc);
 const		HnswTypeInfo *HnswGetTypeInfo(Relation index);
 PGDLLEXPORT void HnswParallelBuildMain(dsm_segment *seg, shm_toc *toc);
 
@@ -457,6 +657,7 @@ IndexScanDesc hnswbeginscan(Relation index, int nkeys, int norderbys);
 void		hnswrescan(IndexScanDesc scan, ScanKey keys, int nkeys, ScanKey orderbys, int norderbys);
 bool		hnswgettuple(IndexScanDesc scan, ScanDirection dir);
 void		hnswendscan(IndexScanDesc scan);
+bool		hnswcanreturn(Relation index, int attno);
 
 static inline HnswNeighborArray *
 HnswGetNeighbors(char *base, HnswElement element, int lc)
@@ -468,6 +669,37 @@ HnswGetNeighbors(char *base, HnswElement element, int lc)
 	return HnswPtrAccess(base, neighborList[lc]);
 }
 
+/*
+ * Calculate the distance between values
+ */
+static inline double
+HnswGetDistance(Datum a, Datum b, HnswSupport * support)
+{
+	IndexStatsCount(INDEX_STATS_DISTANCES, 1);
+
+	if (support->kernel != NULL)
+		return support->kernel(a, b);
+
+	return DatumGetFloat8(FunctionCall2Coll(support->procinfo, support->collation, a, b));
+}
+
+/*
+ * Calculate the distances from a value to many values
+ */
+static inline void
+HnswGetDistances(Datum a, Datum *b, int n, double *distances, HnswSupport * support)
+{
+	if (support->batchKernel != NULL)
+	{
+		IndexStatsCount(INDEX_STATS_DISTANCES, n);
+		support->batchKernel(a, b, n, distances);
+		return;
+	}
+
+	for (int i = 0; i < n; i++)
+		distances[i] = HnswGetDistance(a, b[i], support);
+}
+
 /* Hash tables */
 typedef struct TidHashEntry
 {
@@ -482,30 +714,4 @@ typedef struct TidHashEntry
 #define SH_DECLARE
 #include "lib/simplehash.h"
 
-typedef struct PointerHashEntry
-{
-	uintptr_t	ptr;
-	char		status;
-}			PointerHashEntry;
-
-#define SH_PREFIX pointerhash
-#define SH_ELEMENT_TYPE PointerHashEntry
-#define SH_KEY_TYPE uintptr_t
-#define SH_SCOPE extern
-#define SH_DECLARE
-#include "lib/simplehash.h"
-
-typedef struct OffsetHashEntry
-{
-	Size		offset;
-	char		status;
-}			OffsetHashEntry;
-
-#define SH_PREFIX offsethash
-#define SH_ELEMENT_TYPE OffsetHashEntry
-#define SH_KEY_TYPE Size
-#define SH_SCOPE extern
-#define SH_DECLARE
-#include "lib/simplehash.h"
-
 #endif
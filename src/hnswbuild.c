@@ -18,12 +18,23 @@
  * "relative pointers", stored as an offset from 'hnswarea'.
  *
  * Each element is protected by an LWLock. It must be held when reading or
- * modifying the element's neighbors or 'heaptids'.
+ * modifying the element's neighbors or 'heaptids'. To avoid contention on
+ * the allocator lock, each process reserves chunks of the shared area and
+ * allocates its elements from them without locking.
  *
  * In a non-parallel build, the graph is held in backend-private memory. All
  * the elements are allocated in a dedicated memory context, 'graphCtx', and
  * the pointers used in the graph are regular pointers.
  *
+ * If hnsw.partitioned_build is enabled, the graph is instead written to pages
+ * as a partition and the memory is reused to build the next partition. After
+ * all tuples are loaded, each element of later partitions searches the whole
+ * graph on disk and merges the neighbors found with its existing ones, which
+ * connects the partitions (see RefinePartitions()). Elements already have
+ * neighbors from their partition, so this search uses a smaller candidate
+ * list than inserts on disk. In a parallel build, workers wait for the leader
+ * to write the last partition and then refine blocks alongside it.
+ *
  * 2. On-disk phase
  *
  * In the on-disk phase, the index is built by inserting each vector to the
@@ -33,6 +44,10 @@
  *
  * After we have finished building the graph, we perform one more scan through
  * the index and write all the pages to the WAL.
+ *
+ * If the graph was fully built in memory, the pages are instead written with
+ * a bulk writer (see BulkWritePages()), which bypasses shared buffers and
+ * WAL-logs the pages as they are written.
  */
 #include "postgres.h"
 
@@ -43,6 +58,7 @@
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xloginsert.h"
+#include "bulkwrite.h"
 #include "catalog/index.h"
 #include "catalog/pg_type_d.h"
 #include "commands/progress.h"
@@ -70,23 +86,13 @@
 #define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xA000000000000003)
 
 /*
- * Create the metapage
+ * Set the metapage data
  */
 static void
-CreateMetaPage(HnswBuildState * buildstate)
+SetMetaPageData(HnswBuildState * buildstate, Page page)
 {
-	Relation	index = buildstate->index;
-	ForkNumber	forkNum = buildstate->forkNum;
-	Buffer		buf;
-	Page		page;
-	HnswMetaPage metap;
+	HnswMetaPage metap = HnswPageGetMeta(page);
 
-	buf = HnswNewBuffer(index, forkNum);
-	page = BufferGetPage(buf);
-	HnswInitPage(buf, page);
-
-	/* Set metapage data */
-	metap = HnswPageGetMeta(page);
 	metap->magicNumber = HNSW_MAGIC_NUMBER;
 	metap->version = HNSW_VERSION;
 	metap->dimensions = buildstate->dimensions;
@@ -96,8 +102,27 @@ CreateMetaPage(HnswBuildState * buildstate)
 	metap->entryOffno = InvalidOffsetNumber;
 	metap->entryLevel = -1;
 	metap->insertPage = InvalidBlockNumber;
+	/* Random so entries cached for a previous relation do not match */
+	metap->cacheVersion = RandomInt();
+	metap->upperVersion = 0;
 	((PageHeader) page)->pd_lower =
 		((char *) metap + sizeof(HnswMetaPageData)) - (char *) page;
+}
+
+/*
+ * Create the metapage
+ */
+static void
+CreateMetaPage(HnswBuildState * buildstate)
+{
+	Buffer		buf;
+	Page		page;
+
+	buf = HnswNewBuffer(buildstate->index, buildstate->forkNum);
+	page = BufferGetPage(buf);
+	HnswInitPage(buf, page);
+
+	SetMetaPageData(buildstate, page);
 
 	MarkBufferDirty(buf);
 	UnlockReleaseBuffer(buf);
@@ -156,10 +181,20 @@ CreateGraphPages(HnswBuildState * buildstate)
 	etup = palloc0(HNSW_TUPLE_ALLOC_SIZE);
 	ntup = palloc0(HNSW_TUPLE_ALLOC_SIZE);
 
-	/* Prepare first page */
-	buf = HnswNewBuffer(index, forkNum);
-	page = BufferGetPage(buf);
-	HnswInitPage(buf, page);
+	/* Continue on the last page of the previous partition */
+	if (buildstate->graph->partitions > 0)
+	{
+		buf = ReadBufferExtended(index, forkNum, buildstate->graph->insertPage, RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+	}
+	else
+	{
+		/* Prepare first page */
+		buf = HnswNewBuffer(index, forkNum);
+		page = BufferGetPage(buf);
+		HnswInitPage(buf, page);
+	}
 
 	while (!HnswPtrIsNull(base, iter))
 	{
@@ -176,7 +211,7 @@ CreateGraphPages(HnswBuildState * buildstate)
 		MemSet(etup, 0, HNSW_TUPLE_ALLOC_SIZE);
 
 		/* Calculate sizes */
-		etupSize = HNSW_ELEMENT_TUPLE_SIZE(VARSIZE_ANY(valuePtr));
+		etupSize = HNSW_ELEMENT_TUPLE_SIZE(HnswElementDataSize(valuePtr, buildstate->sq8, buildstate->attrs));
 		ntupSize = HNSW_NEIGHBOR_TUPLE_SIZE(element->level, buildstate->m);
 		combinedSize = etupSize + ntupSize + sizeof(ItemIdData);
 
@@ -186,7 +221,7 @@ CreateGraphPages(HnswBuildState * buildstate)
 					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 					 errmsg("index tuple too large")));
 
-		HnswSetElementTuple(base, etup, element);
+		HnswSetElementTuple(base, etup, element, buildstate->sq8, buildstate->attrs);
 
 		/* Keep element and neighbors on the same page if possible */
 		if (PageGetFreeSpace(page) < etupSize || (combinedSize <= maxSize && PageGetFreeSpace(page) < combinedSize))
@@ -208,6 +243,10 @@ CreateGraphPages(HnswBuildState * buildstate)
 
 		ItemPointerSet(&etup->neighbortid, element->neighborPage, element->neighborOffno);
 
+		/* Start of the elements to refine */
+		if (buildstate->graph->partitions > 0 && !ItemPointerIsValid(&buildstate->graph->partitionStart))
+			ItemPointerSet(&buildstate->graph->partitionStart, element->blkno, element->offno);
+
 		/* Add element */
 		if (PageAddItem(page, (Item) etup, etupSize, InvalidOffsetNumber, false, false) != element->offno)
 			elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
@@ -222,13 +261,20 @@ CreateGraphPages(HnswBuildState * buildstate)
 	}
 
 	insertPage = BufferGetBlockNumber(buf);
+	buildstate->graph->insertPage = insertPage;
 
 	/* Commit */
 	MarkBufferDirty(buf);
 	UnlockReleaseBuffer(buf);
 
-	entryPoint = HnswPtrAccess(base, buildstate->graph->entryPoint);
-	HnswUpdateMetaPage(index, HNSW_UPDATE_ENTRY_ALWAYS, entryPoint, insertPage, forkNum, true);
+	/* Later partitions are reached from the first until refined */
+	if (buildstate->graph->partitions == 0)
+	{
+		entryPoint = HnswPtrAccess(base, buildstate->graph->entryPoint);
+		HnswUpdateMetaPage(index, HNSW_UPDATE_ENTRY_ALWAYS, entryPoint, insertPage, forkNum, true);
+	}
+	else
+		HnswUpdateMetaPage(index, 0, NULL, insertPage, forkNum, true);
 
 	pfree(etup);
 	pfree(ntup);
@@ -285,23 +331,549 @@ WriteNeighborTuples(HnswBuildState * buildstate)
 }
 
 /*
- * Flush pages
+ * Order elements by a breadth-first traversal of layer 0 from the entry
+ * point, so neighbors are written on the same or nearby pages
  */
 static void
-FlushPages(HnswBuildState * buildstate)
+ReorderGraph(HnswBuildState * buildstate)
+{
+	HnswGraph  *graph = buildstate->graph;
+	char	   *base = buildstate->hnswarea;
+	HnswElement entryPoint = HnswPtrAccess(base, graph->entryPoint);
+	HnswElementPtr iter = graph->head;
+	uint32		maxId = pg_atomic_read_u32(&graph->elementCount);
+	HnswElement *order;
+	bool	   *added;
+	int64		count = 0;
+	int64		length = 0;
+
+	if (entryPoint == NULL)
+		return;
+
+	/* Count elements */
+	while (!HnswPtrIsNull(base, iter))
+	{
+		count++;
+		iter = HnswPtrAccess(base, iter)->next;
+	}
+
+	order = MemoryContextAllocHuge(CurrentMemoryContext, sizeof(HnswElement) * count);
+	added = MemoryContextAllocExtended(CurrentMemoryContext, sizeof(bool) * maxId, MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+
+	order[length++] = entryPoint;
+	added[entryPoint->id] = true;
+
+	for (int64 i = 0; i < length; i++)
+	{
+		HnswNeighborArray *neighbors = HnswGetNeighbors(base, order[i], 0);
+
+		for (int j = 0; j < neighbors->length; j++)
+		{
+			HnswElement e = HnswPtrAccess(base, neighbors->items[j].element);
+
+			if (!added[e->id])
+			{
+				added[e->id] = true;
+				order[length++] = e;
+			}
+		}
+	}
+
+	/* Add elements not reachable on layer 0 in their original order */
+	iter = graph->head;
+	while (!HnswPtrIsNull(base, iter))
+	{
+		HnswElement e = HnswPtrAccess(base, iter);
+
+		if (!added[e->id])
+			order[length++] = e;
+
+		iter = e->next;
+	}
+
+	Assert(length == count);
+
+	/* Relink list */
+	HnswPtrStore(base, graph->head, order[0]);
+	for (int64 i = 0; i < length; i++)
+		HnswPtrStore(base, order[i]->next, i + 1 < length ? order[i + 1] : (HnswElement) NULL);
+
+	pfree(order);
+	pfree(added);
+}
+
+/*
+ * Init a page from the bulk writer
+ */
+static void
+HnswBulkInitPage(Page page)
+{
+	PageInit(page, BLCKSZ, sizeof(HnswPageOpaqueData));
+	HnswPageGetOpaque(page)->nextblkno = InvalidBlockNumber;
+	HnswPageGetOpaque(page)->page_id = HNSW_PAGE_ID;
+}
+
+/*
+ * Add a new page, reusing the current one if not writing
+ */
+static void
+HnswBulkAppendPage(BulkWriter * writer, Page *page, BlockNumber *blkno)
+{
+	/* Update previous page */
+	HnswPageGetOpaque(*page)->nextblkno = *blkno + 1;
+
+	if (writer != NULL)
+	{
+		BulkWriterWrite(writer, *blkno, *page);
+		*page = BulkWriterGetPage(writer);
+	}
+
+	/* Can take a while, so ensure we can interrupt */
+	CHECK_FOR_INTERRUPTS();
+
+	/* Prepare new page */
+	HnswBulkInitPage(*page);
+	(*blkno)++;
+}
+
+/*
+ * Lay out graph pages and write them if a writer is passed
+ *
+ * Neighbor tuples need the offsets of all elements, so this is called once
+ * without a writer to calculate them, and once more to write the same
+ * layout with the neighbors in place. Returns the last page.
+ */
+static BlockNumber
+BulkWriteGraphPages(HnswBuildState * buildstate, BulkWriter * writer)
+{
+	Relation	index = buildstate->index;
+	int			m = buildstate->m;
+	Size		maxSize = HNSW_MAX_SIZE;
+	HnswElementPtr iter = buildstate->graph->head;
+	char	   *base = buildstate->hnswarea;
+	BlockNumber blkno = HNSW_METAPAGE_BLKNO + 1;
+	HnswElementTuple etup;
+	HnswNeighborTuple ntup;
+	Page		page;
+
+	/* Allocate once */
+	etup = palloc0(HNSW_TUPLE_ALLOC_SIZE);
+	ntup = palloc0(HNSW_TUPLE_ALLOC_SIZE);
+
+	/* Prepare first page */
+	page = writer != NULL ? BulkWriterGetPage(writer) : palloc(BLCKSZ);
+	HnswBulkInitPage(page);
+
+	while (!HnswPtrIsNull(base, iter))
+	{
+		HnswElement element = HnswPtrAccess(base, iter);
+		Size		etupSize;
+		Size		ntupSize;
+		Size		combinedSize;
+		Pointer		valuePtr = HnswPtrAccess(base, element->value);
+
+		/* Update iterator */
+		iter = element->next;
+
+		/* Calculate sizes */
+		etupSize = HNSW_ELEMENT_TUPLE_SIZE(HnswElementDataSize(valuePtr, buildstate->sq8, buildstate->attrs));
+		ntupSize = HNSW_NEIGHBOR_TUPLE_SIZE(element->level, m);
+		combinedSize = etupSize + ntupSize + sizeof(ItemIdData);
+
+		/* Initial size check */
+		if (etupSize > HNSW_TUPLE_ALLOC_SIZE)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("index tuple too large")));
+
+		/* Keep element and neighbors on the same page if possible */
+		if (PageGetFreeSpace(page) < etupSize || (combinedSize <= maxSize && PageGetFreeSpace(page) < combinedSize))
+			HnswBulkAppendPage(writer, &page, &blkno);
+
+		if (writer == NULL)
+		{
+			/* Calculate offsets */
+			element->blkno = blkno;
+			element->offno = OffsetNumberNext(PageGetMaxOffsetNumber(page));
+			if (combinedSize <= maxSize)
+			{
+				element->neighborPage = element->blkno;
+				element->neighborOffno = OffsetNumberNext(element->offno);
+			}
+			else
+			{
+				element->neighborPage = element->blkno + 1;
+				element->neighborOffno = FirstOffsetNumber;
+			}
+		}
+		else
+		{
+			/* Zero memory for each element */
+			MemSet(etup, 0, HNSW_TUPLE_ALLOC_SIZE);
+			HnswSetElementTuple(base, etup, element, buildstate->sq8, buildstate->attrs);
+			ItemPointerSet(&etup->neighbortid, element->neighborPage, element->neighborOffno);
+		}
+
+		/* Add element */
+		if (element->blkno != blkno || PageAddItem(page, (Item) etup, etupSize, InvalidOffsetNumber, false, false) != element->offno)
+			elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
+
+		/* Add new page if needed */
+		if (PageGetFreeSpace(page) < ntupSize)
+			HnswBulkAppendPage(writer, &page, &blkno);
+
+		if (writer != NULL)
+		{
+			/* Zero memory for each element */
+			MemSet(ntup, 0, HNSW_TUPLE_ALLOC_SIZE);
+			HnswSetNeighborTuple(base, ntup, element, m);
+		}
+
+		/* Add neighbors */
+		if (element->neighborPage != blkno || PageAddItem(page, (Item) ntup, ntupSize, InvalidOffsetNumber, false, false) != element->neighborOffno)
+			elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
+	}
+
+	if (writer != NULL)
+		BulkWriterWrite(writer, blkno, page);
+	else
+		pfree(page);
+
+	pfree(etup);
+	pfree(ntup);
+
+	return blkno;
+}
+
+/*
+ * Write the graph in memory to pages without going through shared buffers
+ */
+static void
+BulkWritePages(HnswBuildState * buildstate)
+{
+	HnswElement entryPoint = HnswPtrAccess(buildstate->hnswarea, buildstate->graph->entryPoint);
+	BulkWriter *writer;
+	BlockNumber insertPage;
+	Page		page;
+
+#ifdef HNSW_MEMORY
+	elog(INFO, "memory: %zu MB", buildstate->graph->memoryUsed / (1024 * 1024));
+#endif
+
+	if (hnsw_reorder_build)
+		ReorderGraph(buildstate);
+
+	/* Calculate offsets */
+	insertPage = BulkWriteGraphPages(buildstate, NULL);
+
+	writer = BulkWriterStart(buildstate->index, buildstate->forkNum);
+
+	/* Create the metapage */
+	page = BulkWriterGetPage(writer);
+	HnswBulkInitPage(page);
+	SetMetaPageData(buildstate, page);
+	HnswUpdateMetaPageInfo(page, HNSW_UPDATE_ENTRY_ALWAYS, entryPoint, insertPage);
+	BulkWriterWrite(writer, HNSW_METAPAGE_BLKNO, page);
+
+	/* Create graph pages */
+	BulkWriteGraphPages(buildstate, writer);
+
+	BulkWriterFinish(writer);
+
+	buildstate->graph->flushed = true;
+	buildstate->bulkWritten = true;
+}
+
+/*
+ * Write the graph in memory to pages
+ */
+static void
+WritePartition(HnswBuildState * buildstate)
 {
 #ifdef HNSW_MEMORY
 	elog(INFO, "memory: %zu MB", buildstate->graph->memoryUsed / (1024 * 1024));
 #endif
 
-	CreateMetaPage(buildstate);
+	if (hnsw_reorder_build)
+		ReorderGraph(buildstate);
+
+	if (buildstate->graph->partitions == 0)
+		CreateMetaPage(buildstate);
+
 	CreateGraphPages(buildstate);
 	WriteNeighborTuples(buildstate);
 
+	buildstate->graph->partitions++;
+}
+
+/*
+ * Flush pages
+ */
+static void
+FlushPages(HnswBuildState * buildstate)
+{
+	WritePartition(buildstate);
+
 	buildstate->graph->flushed = true;
 	MemoryContextReset(buildstate->graphCtx);
 }
 
+/*
+ * Flush pages and reuse the memory for a new partition
+ */
+static void
+StartPartition(HnswBuildState * buildstate)
+{
+	HnswGraph  *graph = buildstate->graph;
+	char	   *base = buildstate->hnswarea;
+
+	WritePartition(buildstate);
+
+	HnswPtrStore(base, graph->head, (HnswElement) NULL);
+	HnswPtrStore(base, graph->entryPoint, (HnswElement) NULL);
+
+	/* Reuse element ids so visited arrays stay sized to a partition */
+	pg_atomic_write_u32(&graph->elementCount, 0);
+
+	if (base == NULL)
+	{
+		MemoryContextReset(buildstate->graphCtx);
+		graph->memoryUsed = 0;
+	}
+	else
+	{
+		/* Chunks reserved by each process are discarded */
+#if PG_VERSION_NUM < 140005
+		graph->memoryUsed = MAXALIGN(1);
+#else
+		graph->memoryUsed = 0;
+#endif
+	}
+}
+
+/*
+ * Merge neighbors found on disk with the ones from its partition and update
+ * the element and its neighbors. Returns false if another process updated
+ * the neighbors of the element in the meantime, so it can be refined again.
+ */
+static bool
+RefineElement(HnswBuildState * buildstate, HnswElement element, HnswNeighborTuple ntup, HnswNeighborTuple otup)
+{
+	Relation	index = buildstate->index;
+	ForkNumber	forkNum = buildstate->forkNum;
+	HnswSupport *support = &buildstate->support;
+	int			m = buildstate->m;
+	Size		ntupSize = HNSW_NEIGHBOR_TUPLE_SIZE(element->level, m);
+	LOCKMODE	lockmode = ShareLock;
+	HnswElement entryPoint;
+	HnswQuery	q;
+	Buffer		buf;
+	Page		page;
+	bool		changed;
+	char	   *base = NULL;
+
+	/* Same locking as inserts on disk, since other processes may be refining */
+	LockPage(index, HNSW_UPDATE_LOCK, lockmode);
+	entryPoint = HnswGetEntryPoint(index);
+
+	/* Prevent concurrent refines when likely updating entry point */
+	if (entryPoint != NULL && element->level > entryPoint->level)
+	{
+		UnlockPage(index, HNSW_UPDATE_LOCK, lockmode);
+		lockmode = ExclusiveLock;
+		LockPage(index, HNSW_UPDATE_LOCK, lockmode);
+		entryPoint = HnswGetEntryPoint(index);
+	}
+
+	/* Skip if element is entry point */
+	if (entryPoint == NULL || (element->blkno == entryPoint->blkno && element->offno == entryPoint->offno))
+	{
+		UnlockPage(index, HNSW_UPDATE_LOCK, lockmode);
+		return true;
+	}
+
+	/* Copy neighbors from its partition to detect concurrent updates */
+	buf = ReadBufferExtended(index, forkNum, element->neighborPage, RBM_NORMAL, NULL);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buf);
+	memcpy(otup, PageGetItem(page, PageGetItemId(page, element->neighborOffno)), ntupSize);
+	UnlockReleaseBuffer(buf);
+
+	q.value = HnswGetValue(base, element);
+	q.nkeys = 0;
+
+	/*
+	 * Find neighbors for element, skipping itself. The element already has
+	 * neighbors from its partition, so the search only needs to find the
+	 * nearest elements of other partitions, and ef is bounded by m instead of
+	 * ef_construction.
+	 */
+	HnswInitNeighbors(base, element, m, NULL);
+	HnswFindElementNeighbors(base, element, entryPoint, index, support, m, m, true, NULL);
+
+	/* Add neighbors from its partition, which may not be reachable yet */
+	for (int lc = element->level; lc >= 0; lc--)
+	{
+		int			lm = HnswGetLayerM(m, lc);
+		HnswNeighborArray *neighbors = HnswGetNeighbors(base, element, lc);
+		ItemPointer indextids = otup->indextids + (element->level - lc) * m;
+
+		for (int i = 0; i < lm; i++)
+		{
+			ItemPointer indextid = &indextids[i];
+			BlockNumber blkno;
+			OffsetNumber offno;
+			HnswElement e;
+			double		distance;
+			bool		found = false;
+
+			if (!ItemPointerIsValid(indextid))
+				break;
+
+			blkno = ItemPointerGetBlockNumber(indextid);
+			offno = ItemPointerGetOffsetNumber(indextid);
+
+			for (int j = 0; j < neighbors->length; j++)
+			{
+				HnswElement neighborElement = HnswPtrAccess(base, neighbors->items[j].element);
+
+				if (neighborElement->blkno == blkno && neighborElement->offno == offno)
+				{
+					found = true;
+					break;
+				}
+			}
+
+			if (found)
+				continue;
+
+			e = HnswInitElementFromBlock(blkno, offno);
+			HnswLoadElement(e, &distance, &q, index, support, true, NULL);
+			HnswUpdateConnection(base, neighbors, e, distance, lm, NULL, index, support);
+		}
+	}
+
+	/* Zero memory for each element */
+	MemSet(ntup, 0, HNSW_TUPLE_ALLOC_SIZE);
+	HnswSetNeighborTuple(base, ntup, element, m);
+
+	/* Overwrite tuple unless another process added itself as a neighbor */
+	buf = ReadBufferExtended(index, forkNum, element->neighborPage, RBM_NORMAL, NULL);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	page = BufferGetPage(buf);
+
+	changed = memcmp(PageGetItem(page, PageGetItemId(page, element->neighborOffno)), otup, ntupSize) != 0;
+	if (!changed)
+	{
+		if (!PageIndexTupleOverwrite(page, element->neighborOffno, (Item) ntup, ntupSize))
+			elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
+
+		/* Commit */
+		MarkBufferDirty(buf);
+	}
+
+	UnlockReleaseBuffer(buf);
+
+	if (!changed)
+	{
+		/* Update neighbors */
+		HnswUpdateNeighborsOnDisk(index, support, element, m, true, true);
+
+		/* Update entry point if needed */
+		if (element->level > entryPoint->level)
+			HnswUpdateMetaPage(index, HNSW_UPDATE_ENTRY_GREATER, element, InvalidBlockNumber, forkNum, true);
+	}
+
+	UnlockPage(index, HNSW_UPDATE_LOCK, lockmode);
+
+	return !changed;
+}
+
+/*
+ * Get the next block to refine, or InvalidBlockNumber when done
+ */
+static BlockNumber
+GetRefineBlock(HnswShared * hnswshared, BlockNumber *nextBlock, BlockNumber endBlock)
+{
+	BlockNumber blkno;
+
+	if (hnswshared == NULL)
+		return *nextBlock < endBlock ? (*nextBlock)++ : InvalidBlockNumber;
+
+	SpinLockAcquire(&hnswshared->mutex);
+	blkno = hnswshared->refineNextBlock;
+	if (blkno < hnswshared->refineEndBlock)
+		hnswshared->refineNextBlock++;
+	else
+		blkno = InvalidBlockNumber;
+	SpinLockRelease(&hnswshared->mutex);
+
+	return blkno;
+}
+
+/*
+ * Connect partitions by refining each element after the first partition
+ *
+ * In a parallel build, each participant claims blocks from the shared state
+ */
+static void
+RefinePartitions(HnswBuildState * buildstate, HnswShared * hnswshared)
+{
+	Relation	index = buildstate->index;
+	ItemPointer start = &buildstate->graph->partitionStart;
+	BlockNumber startPage = ItemPointerGetBlockNumber(start);
+	BlockNumber nextBlock = startPage;
+	BlockNumber endBlock = RelationGetNumberOfBlocksInFork(index, buildstate->forkNum);
+	BlockNumber blkno;
+	HnswNeighborTuple ntup = palloc(HNSW_TUPLE_ALLOC_SIZE);
+	HnswNeighborTuple otup = palloc(HNSW_TUPLE_ALLOC_SIZE);
+	MemoryContext oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+	while ((blkno = GetRefineBlock(hnswshared, &nextBlock, endBlock)) != InvalidBlockNumber)
+	{
+		Buffer		buf;
+		Page		page;
+		OffsetNumber maxoffno;
+		OffsetNumber offnos[MaxOffsetNumber];
+		int			offnosLength = 0;
+
+		/* Get element offsets, and release the page before updating */
+		buf = ReadBufferExtended(index, buildstate->forkNum, blkno, RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		maxoffno = PageGetMaxOffsetNumber(page);
+
+		for (OffsetNumber offno = blkno == startPage ? ItemPointerGetOffsetNumber(start) : FirstOffsetNumber; offno <= maxoffno; offno = OffsetNumberNext(offno))
+		{
+			HnswElementTuple etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, offno));
+
+			if (HnswIsElementTuple(etup))
+				offnos[offnosLength++] = offno;
+		}
+
+		UnlockReleaseBuffer(buf);
+
+		for (int i = 0; i < offnosLength; i++)
+		{
+			HnswElement element = HnswInitElementFromBlock(blkno, offnos[i]);
+
+			/* Can take a while, so ensure we can interrupt */
+			CHECK_FOR_INTERRUPTS();
+
+			HnswLoadElement(element, NULL, NULL, index, &buildstate->support, true, NULL);
+
+			while (!RefineElement(buildstate, element, ntup, otup))
+				CHECK_FOR_INTERRUPTS();
+
+			MemoryContextReset(buildstate->tmpCtx);
+		}
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+	pfree(ntup);
+	pfree(otup);
+}
+
 /*
  * Add a heap TID to an existing element
  */
@@ -327,7 +899,7 @@ AddDuplicateInMemory(HnswElement element, HnswElement dup)
  * Find duplicate element
  */
 static bool
-FindDuplicateInMemory(char *base, HnswElement element)
+FindDuplicateInMemory(char *base, HnswElement element, bool attrs)
 {
 	HnswNeighborArray *neighbors = HnswGetNeighbors(base, element, 0);
 	Datum		value = HnswGetValue(base, element);
@@ -342,6 +914,10 @@ FindDuplicateInMemory(char *base, HnswElement element)
 		if (!datumIsEqual(value, neighborValue, false, -1))
 			return false;
 
+		/* Other columns must match as well */
+		if (attrs && !HnswAttrsEqual(value, neighborValue))
+			continue;
+
 		/* Check for space */
 		if (AddDuplicateInMemory(element, neighborElement))
 			return true;
@@ -368,27 +944,53 @@ AddElementInMemory(char *base, HnswGraph * graph, HnswElement element)
 static void
 UpdateNeighborsInMemory(char *base, HnswSupport * support, HnswElement e, int m)
 {
+	HnswNeighborArray **neighborhoods = palloc((e->level + 1) * sizeof(HnswNeighborArray *));
+
+	/* Copy neighbors to local memory */
+	LWLockAcquire(&e->lock, LW_SHARED);
 	for (int lc = e->level; lc >= 0; lc--)
 	{
-		int			lm = HnswGetLayerM(m, lc);
-		Size		neighborsSize = HNSW_NEIGHBOR_ARRAY_SIZE(lm);
-		HnswNeighborArray *neighbors = palloc(neighborsSize);
+		Size		neighborsSize = HNSW_NEIGHBOR_ARRAY_SIZE(HnswGetLayerM(m, lc));
 
-		/* Copy neighbors to local memory */
-		LWLockAcquire(&e->lock, LW_SHARED);
-		memcpy(neighbors, HnswGetNeighbors(base, e, lc), neighborsSize);
-		LWLockRelease(&e->lock);
+		neighborhoods[lc] = palloc(neighborsSize);
+		memcpy(neighborhoods[lc], HnswGetNeighbors(base, e, lc), neighborsSize);
+	}
+	LWLockRelease(&e->lock);
+
+	for (int lc = e->level; lc >= 0; lc--)
+	{
+		HnswNeighborArray *neighbors = neighborhoods[lc];
 
 		for (int i = 0; i < neighbors->length; i++)
 		{
 			HnswCandidate *hc = &neighbors->items[i];
 			HnswElement neighborElement = HnswPtrAccess(base, hc->element);
 
-			/* Keep scan-build happy on Mac x86-64 */
-			Assert(neighborElement);
+			/* Already updated with a higher layer */
+			if (neighborElement == NULL)
+				continue;
 
 			LWLockAcquire(&neighborElement->lock, LW_EXCLUSIVE);
-			HnswUpdateConnection(base, HnswGetNeighbors(base, neighborElement, lc), e, hc->distance, lm, NULL, NULL, support);
+			HnswUpdateConnection(base, HnswGetNeighbors(base, neighborElement, lc), e, hc->distance, HnswGetLayerM(m, lc), NULL, NULL, support);
+
+			/* Update lower layers with the same lock */
+			for (int lc2 = lc - 1; lc2 >= 0; lc2--)
+			{
+				HnswNeighborArray *lowerNeighbors = neighborhoods[lc2];
+
+				for (int j = 0; j < lowerNeighbors->length; j++)
+				{
+					HnswCandidate *hc2 = &lowerNeighbors->items[j];
+
+					if (HnswPtrAccess(base, hc2->element) != neighborElement)
+						continue;
+
+					HnswUpdateConnection(base, HnswGetNeighbors(base, neighborElement, lc2), e, hc2->distance, HnswGetLayerM(m, lc2), NULL, NULL, support);
+					HnswPtrStore(base, hc2->element, (HnswElement) NULL);
+					break;
+				}
+			}
+
 			LWLockRelease(&neighborElement->lock);
 		}
 	}
@@ -404,7 +1006,7 @@ UpdateGraphInMemory(HnswSupport * support, HnswElement element, int m, int efCon
 	char	   *base = buildstate->hnswarea;
 
 	/* Look for duplicate */
-	if (FindDuplicateInMemory(base, element))
+	if (FindDuplicateInMemory(base, element, buildstate->attrs))
 		return;
 
 	/* Add element */
@@ -434,8 +1036,11 @@ InsertTupleInMemory(HnswBuildState * buildstate, HnswElement element)
 	char	   *base = buildstate->hnswarea;
 
 	/* Wait if another process needs exclusive lock on entry lock */
-	LWLockAcquire(entryWaitLock, LW_EXCLUSIVE);
-	LWLockRelease(entryWaitLock);
+	if (pg_atomic_read_u32(&graph->entryWaiters) > 0)
+	{
+		LWLockAcquire(entryWaitLock, LW_EXCLUSIVE);
+		LWLockRelease(entryWaitLock);
+	}
 
 	/* Get entry point */
 	LWLockAcquire(entryLock, LW_SHARED);
@@ -448,16 +1053,18 @@ InsertTupleInMemory(HnswBuildState * buildstate, HnswElement element)
 		LWLockRelease(entryLock);
 
 		/* Tell other processes to wait and get exclusive lock */
+		pg_atomic_fetch_add_u32(&graph->entryWaiters, 1);
 		LWLockAcquire(entryWaitLock, LW_EXCLUSIVE);
 		LWLockAcquire(entryLock, LW_EXCLUSIVE);
 		LWLockRelease(entryWaitLock);
+		pg_atomic_fetch_sub_u32(&graph->entryWaiters, 1);
 
 		/* Get latest entry point after lock is acquired */
 		entryPoint = HnswPtrAccess(base, graph->entryPoint);
 	}
 
 	/* Find neighbors for element */
-	HnswFindElementNeighbors(base, element, entryPoint, NULL, support, m, efConstruction, false);
+	HnswFindElementNeighbors(base, element, entryPoint, NULL, support, m, efConstruction, false, &buildstate->visited);
 
 	/* Update graph in memory */
 	UpdateGraphInMemory(support, element, m, efConstruction, entryPoint, buildstate);
@@ -466,6 +1073,68 @@ InsertTupleInMemory(HnswBuildState * buildstate, HnswElement element)
 	LWLockRelease(entryLock);
 }
 
+/*
+ * Get the max memory for an element
+ */
+static Size
+ElementMaxSize(HnswBuildState * buildstate, Size valueSize)
+{
+	Size		size = MAXALIGN(sizeof(HnswElementData)) + MAXALIGN(sizeof(HnswNeighborArrayPtr) * (buildstate->maxLevel + 1)) + MAXALIGN(valueSize);
+
+	for (int lc = 0; lc <= buildstate->maxLevel; lc++)
+		size += MAXALIGN(HNSW_NEIGHBOR_ARRAY_SIZE(HnswGetLayerM(buildstate->m, lc)));
+
+	return size;
+}
+
+/*
+ * Ensure memory is available for an element
+ */
+static bool
+ReserveElementMemory(HnswBuildState * buildstate, Size valueSize)
+{
+	HnswGraph  *graph = buildstate->graph;
+	Size		size;
+	bool		reserved;
+
+	/* Non-parallel builds allocate from a memory context */
+	if (buildstate->hnswarea == NULL)
+		return graph->memoryUsed < graph->memoryTotal;
+
+	/* Chunks from previous partitions were reused */
+	if (buildstate->chunkPartition != graph->partitions)
+	{
+		buildstate->chunkFree = 0;
+		buildstate->chunkPartition = graph->partitions;
+	}
+
+	/* Use the chunk reserved by this process if possible */
+	size = ElementMaxSize(buildstate, valueSize);
+	if (buildstate->chunkFree >= size)
+		return true;
+
+	/*
+	 * In a parallel build, the HnswElement is allocated from the shared
+	 * memory area, so we need to coordinate with other processes. The area
+	 * has enough space past memoryTotal for the last chunk.
+	 */
+	LWLockAcquire(&graph->allocatorLock, LW_EXCLUSIVE);
+
+	reserved = graph->memoryUsed < graph->memoryTotal;
+	if (reserved)
+	{
+		Size		chunkSize = Max(HNSW_BUILD_CHUNK_SIZE, size);
+
+		buildstate->chunk = buildstate->hnswarea + graph->memoryUsed;
+		buildstate->chunkFree = chunkSize;
+		graph->memoryUsed += chunkSize;
+	}
+
+	LWLockRelease(&graph->allocatorLock);
+
+	return reserved;
+}
+
 /*
  * Insert tuple
  */
@@ -486,8 +1155,12 @@ InsertTuple(Relation index, Datum *values, bool *isnull, ItemPointer heaptid, Hn
 	if (!HnswFormIndexValue(&value, values, isnull, buildstate->typeInfo, support))
 		return false;
 
+	/* Store other columns with the value */
+	if (buildstate->attrs)
+		value = HnswAppendAttrs(index, value, values, isnull);
+
 	/* Get datum size */
-	valueSize = VARSIZE_ANY(DatumGetPointer(value));
+	valueSize = HnswElementDataSize(DatumGetPointer(value), false, buildstate->attrs);
 
 	/* Ensure graph not flushed when inserting */
 	LWLockAcquire(flushLock, LW_SHARED);
@@ -500,23 +1173,32 @@ InsertTuple(Relation index, Datum *values, bool *isnull, ItemPointer heaptid, Hn
 		return HnswInsertTupleOnDisk(index, support, value, heaptid, true);
 	}
 
-	/*
-	 * In a parallel build, the HnswElement is allocated from the shared
-	 * memory area, so we need to coordinate with other processes.
-	 */
-	LWLockAcquire(&graph->allocatorLock, LW_EXCLUSIVE);
-
-	/*
-	 * Check that we have enough memory available for the new element now that
-	 * we have the allocator lock, and flush pages if needed.
-	 */
-	if (graph->memoryUsed >= graph->memoryTotal)
+	/* Check that we have enough memory available and flush pages if needed */
+	if (!ReserveElementMemory(buildstate, valueSize))
 	{
-		LWLockRelease(&graph->allocatorLock);
-
 		LWLockRelease(flushLock);
 		LWLockAcquire(flushLock, LW_EXCLUSIVE);
 
+		/* Build the next partition in memory if the current one is not empty */
+		if (hnsw_partitioned_build && !graph->flushed && !HnswPtrIsNull(base, graph->head))
+		{
+			/* Another process may have started a new partition */
+			if (graph->memoryUsed >= graph->memoryTotal)
+			{
+				if (graph->partitions == 0)
+					ereport(NOTICE,
+							(errmsg("hnsw graph no longer fits into maintenance_work_mem after " INT64_FORMAT " tuples", (int64) graph->indtuples),
+							 errdetail("Building the graph in partitions will take more time."),
+							 errhint("Increase maintenance_work_mem to speed up builds.")));
+
+				StartPartition(buildstate);
+			}
+
+			LWLockRelease(flushLock);
+
+			return InsertTuple(index, values, isnull, heaptid, buildstate);
+		}
+
 		if (!graph->flushed)
 		{
 			ereport(NOTICE,
@@ -534,15 +1216,9 @@ InsertTuple(Relation index, Datum *values, bool *isnull, ItemPointer heaptid, Hn
 
 	/* Ok, we can proceed to allocate the element */
 	element = HnswInitElement(base, heaptid, buildstate->m, buildstate->ml, buildstate->maxLevel, allocator);
+	element->id = pg_atomic_fetch_add_u32(&graph->elementCount, 1);
 	valuePtr = HnswAlloc(allocator, valueSize);
 
-	/*
-	 * We have now allocated the space needed for the element, so we don't
-	 * need the allocator lock anymore. Release it and initialize the rest of
-	 * the element.
-	 */
-	LWLockRelease(&graph->allocatorLock);
-
 	/* Copy the datum */
 	memcpy(valuePtr, DatumGetPointer(value), valueSize);
 	HnswPtrStore(base, element->value, valuePtr);
@@ -604,7 +1280,12 @@ InitGraph(HnswGraph * graph, char *base, Size memoryTotal)
 	HnswPtrStore(base, graph->entryPoint, (HnswElement) NULL);
 	graph->memoryUsed = 0;
 	graph->memoryTotal = memoryTotal;
+	pg_atomic_init_u32(&graph->elementCount, 0);
+	pg_atomic_init_u32(&graph->entryWaiters, 0);
 	graph->flushed = false;
+	graph->partitions = 0;
+	graph->insertPage = InvalidBlockNumber;
+	ItemPointerSetInvalid(&graph->partitionStart);
 	graph->indtuples = 0;
 	SpinLockInit(&graph->lock);
 	LWLockInitialize(&graph->entryLock, hnsw_lock_tranche_id);
@@ -644,9 +1325,13 @@ static void *
 HnswSharedMemoryAlloc(Size size, void *state)
 {
 	HnswBuildState *buildstate = (HnswBuildState *) state;
-	void	   *chunk = buildstate->hnswarea + buildstate->graph->memoryUsed;
+	void	   *chunk = buildstate->chunk;
+
+	/* Reserved by ReserveElementMemory */
+	Assert(MAXALIGN(size) <= buildstate->chunkFree);
 
-	buildstate->graph->memoryUsed += MAXALIGN(size);
+	buildstate->chunk += MAXALIGN(size);
+	buildstate->chunkFree -= MAXALIGN(size);
 	return chunk;
 }
 
@@ -664,8 +1349,24 @@ InitBuildState(HnswBuildState * buildstate, Relation heap, Relation index, Index
 
 	buildstate->m = HnswGetM(index);
 	buildstate->efConstruction = HnswGetEfConstruction(index);
+	buildstate->sq8 = HnswUseSq8(index);
+	buildstate->attrs = HnswHasAttrs(index);
 	buildstate->dimensions = TupleDescAttr(index->rd_att, 0)->atttypmod;
 
+	/* Vector column must be first and other columns are only for filtering */
+	if (!OidIsValid(index_getprocid(index, 1, HNSW_DISTANCE_PROC)))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("first column of hnsw index must be a vector column")));
+
+	for (int attno = 2; attno <= IndexRelationGetNumberOfKeyAttributes(index); attno++)
+	{
+		if (OidIsValid(index_getprocid(index, attno, HNSW_DISTANCE_PROC)))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("hnsw index can only have one vector column")));
+	}
+
 	/* Disallow varbit since require fixed dimensions */
 	if (TupleDescAttr(index->rd_att, 0)->atttypid == VARBITOID)
 		ereport(ERROR,
@@ -690,6 +1391,7 @@ InitBuildState(HnswBuildState * buildstate, Relation heap, Relation index, Index
 
 	buildstate->reltuples = 0;
 	buildstate->indtuples = 0;
+	buildstate->bulkWritten = false;
 
 	/* Get support functions */
 	HnswInitSupport(&buildstate->support, index);
@@ -711,9 +1413,17 @@ InitBuildState(HnswBuildState * buildstate, Relation heap, Relation index, Index
 
 	InitAllocator(&buildstate->allocator, &HnswMemoryContextAlloc, buildstate);
 
+	/* Grows as needed */
+	buildstate->visited.length = 1024;
+	buildstate->visited.generations = palloc0(buildstate->visited.length * sizeof(uint32));
+	buildstate->visited.generation = 0;
+
 	buildstate->hnswleader = NULL;
 	buildstate->hnswshared = NULL;
 	buildstate->hnswarea = NULL;
+	buildstate->chunk = NULL;
+	buildstate->chunkFree = 0;
+	buildstate->chunkPartition = 0;
 }
 
 /*
@@ -724,6 +1434,7 @@ FreeBuildState(HnswBuildState * buildstate)
 {
 	MemoryContextDelete(buildstate->graphCtx);
 	MemoryContextDelete(buildstate->tmpCtx);
+	pfree(buildstate->visited.generations);
 }
 
 /*
@@ -801,6 +1512,53 @@ HnswParallelScanAndInsert(Relation heapRel, Relation indexRel, HnswShared * hnsw
 	FreeBuildState(&buildstate);
 }
 
+/*
+ * Perform a worker's portion of refining partitions
+ */
+static void
+HnswParallelRefine(Relation heapRel, Relation indexRel, HnswShared * hnswshared, char *hnswarea)
+{
+	HnswBuildState buildstate;
+	IndexInfo  *indexInfo;
+	bool		refine;
+
+	/* Wait for the leader to write the last partition */
+	for (;;)
+	{
+		SpinLockAcquire(&hnswshared->mutex);
+		if (hnswshared->refineReady)
+		{
+			refine = hnswshared->refineNextBlock < hnswshared->refineEndBlock;
+			SpinLockRelease(&hnswshared->mutex);
+			break;
+		}
+		SpinLockRelease(&hnswshared->mutex);
+
+		ConditionVariableSleep(&hnswshared->refinecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+
+	ConditionVariableCancelSleep();
+
+	if (refine)
+	{
+		indexInfo = BuildIndexInfo(indexRel);
+		indexInfo->ii_Concurrent = hnswshared->isconcurrent;
+		InitBuildState(&buildstate, heapRel, indexRel, indexInfo, MAIN_FORKNUM);
+		buildstate.graph = &hnswshared->graphData;
+		buildstate.hnswarea = hnswarea;
+		RefinePartitions(&buildstate, hnswshared);
+		FreeBuildState(&buildstate);
+	}
+
+	SpinLockAcquire(&hnswshared->mutex);
+	hnswshared->nworkersrefined++;
+	SpinLockRelease(&hnswshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&hnswshared->workersdonecv);
+}
+
 /*
  * Perform work within a launched parallel process
  */
@@ -814,6 +1572,8 @@ HnswParallelBuildMain(dsm_segment *seg, shm_toc *toc)
 	Relation	indexRel;
 	LOCKMODE	heapLockmode;
 	LOCKMODE	indexLockmode;
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts;
 
 	/* Set debug_query_string for individual workers first */
 	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
@@ -844,8 +1604,15 @@ HnswParallelBuildMain(dsm_segment *seg, shm_toc *toc)
 	hnswarea = shm_toc_lookup(toc, PARALLEL_KEY_HNSW_AREA, false);
 
 	/* Perform inserts */
+	prevCounts = IndexStatsBegin(&counts);
 	HnswParallelScanAndInsert(heapRel, indexRel, hnswshared, hnswarea, false);
 
+	/* Connect partitions */
+	HnswParallelRefine(heapRel, indexRel, hnswshared, hnswarea);
+
+	IndexStatsEnd(prevCounts);
+	IndexStatsFlush(indexRel, &counts);
+
 	/* Close relations within worker */
 	index_close(indexRel, indexLockmode);
 	table_close(heapRel, heapLockmode);
@@ -888,6 +1655,49 @@ HnswLeaderParticipateAsWorker(HnswBuildState * buildstate)
 	HnswParallelScanAndInsert(buildstate->heap, buildstate->index, hnswleader->hnswshared, hnswleader->hnswarea, true);
 }
 
+/*
+ * Within leader, refine partitions with the workers
+ */
+static void
+HnswLeaderRefine(HnswBuildState * buildstate)
+{
+	HnswLeader *hnswleader = buildstate->hnswleader;
+	HnswShared *hnswshared = hnswleader->hnswshared;
+	ItemPointer start = &buildstate->graph->partitionStart;
+
+	/* Workers wait for this even if there is nothing to refine */
+	SpinLockAcquire(&hnswshared->mutex);
+	if (ItemPointerIsValid(start))
+	{
+		hnswshared->refineNextBlock = ItemPointerGetBlockNumber(start);
+		hnswshared->refineEndBlock = RelationGetNumberOfBlocksInFork(buildstate->index, buildstate->forkNum);
+	}
+	hnswshared->refineReady = true;
+	SpinLockRelease(&hnswshared->mutex);
+
+	ConditionVariableBroadcast(&hnswshared->refinecv);
+
+	if (ItemPointerIsValid(start))
+		RefinePartitions(buildstate, hnswshared);
+
+	/* Wait for all launched workers */
+	for (;;)
+	{
+		SpinLockAcquire(&hnswshared->mutex);
+		if (hnswshared->nworkersrefined == hnswleader->pcxt->nworkers_launched)
+		{
+			SpinLockRelease(&hnswshared->mutex);
+			break;
+		}
+		SpinLockRelease(&hnswshared->mutex);
+
+		ConditionVariableSleep(&hnswshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+
+	ConditionVariableCancelSleep();
+}
+
 /*
  * Begin parallel build
  */
@@ -966,9 +1776,14 @@ HnswBeginParallel(HnswBuildState * buildstate, bool isconcurrent, int request)
 	hnswshared->isconcurrent = isconcurrent;
 	ConditionVariableInit(&hnswshared->workersdonecv);
 	SpinLockInit(&hnswshared->mutex);
+	ConditionVariableInit(&hnswshared->refinecv);
 	/* Initialize mutable state */
 	hnswshared->nparticipantsdone = 0;
 	hnswshared->reltuples = 0;
+	hnswshared->refineReady = false;
+	hnswshared->refineNextBlock = InvalidBlockNumber;
+	hnswshared->refineEndBlock = InvalidBlockNumber;
+	hnswshared->nworkersrefined = 0;
 	table_parallelscan_initialize(buildstate->heap,
 								  ParallelTableScanFromHnswShared(hnswshared),
 								  snapshot);
@@ -1082,7 +1897,22 @@ BuildGraph(HnswBuildState * buildstate, ForkNumber forkNum)
 
 	/* Flush pages */
 	if (!buildstate->graph->flushed)
-		FlushPages(buildstate);
+	{
+		/* Write the complete graph in bulk */
+		if (buildstate->graph->partitions == 0)
+			BulkWritePages(buildstate);
+		else
+			FlushPages(buildstate);
+	}
+
+	/* Connect partitions */
+	if (ItemPointerIsValid(&buildstate->graph->partitionStart))
+		pgstat_progress_update_param(PROGRESS_CREATEIDX_SUBPHASE, PROGRESS_HNSW_PHASE_REFINE);
+
+	if (buildstate->hnswleader)
+		HnswLeaderRefine(buildstate);
+	else if (ItemPointerIsValid(&buildstate->graph->partitionStart))
+		RefinePartitions(buildstate, NULL);
 
 	/* End parallel build */
 	if (buildstate->hnswleader)
@@ -1096,18 +1926,26 @@ static void
 BuildIndex(Relation heap, Relation index, IndexInfo *indexInfo,
 		   HnswBuildState * buildstate, ForkNumber forkNum)
 {
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts;
+
 #ifdef HNSW_MEMORY
 	SeedRandom(42);
 #endif
 
+	prevCounts = IndexStatsBegin(&counts);
 	InitBuildState(buildstate, heap, index, indexInfo, forkNum);
 
 	BuildGraph(buildstate, forkNum);
 
-	if (RelationNeedsWAL(index) || forkNum == INIT_FORKNUM)
+	/* Pages written in bulk are already WAL-logged */
+	if ((RelationNeedsWAL(index) || forkNum == INIT_FORKNUM) && !buildstate->bulkWritten)
 		log_newpage_range(index, forkNum, 0, RelationGetNumberOfBlocksInFork(index, forkNum), true);
 
 	FreeBuildState(buildstate);
+
+	IndexStatsEnd(prevCounts);
+	IndexStatsFlush(index, &counts);
 }
 
 /*
@@ -0,0 +1,752 @@
+#include "postgres.h"
+
+#include "access/generic_xlog.h"
+#include "access/xlog.h"
+#include "common/hashfn.h"
+#include "hnsw.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+#if PG_VERSION_NUM >= 160000
+#define HnswRelFileLocator(index) ((index)->rd_locator)
+#define HnswRelFileSpc(loc) ((loc).spcOid)
+#define HnswRelFileDb(loc) ((loc).dbOid)
+#define HnswRelFileRel(loc) ((loc).relNumber)
+#else
+#define HnswRelFileLocator(index) ((index)->rd_node)
+#define HnswRelFileSpc(loc) ((loc).spcNode)
+#define HnswRelFileDb(loc) ((loc).dbNode)
+#define HnswRelFileRel(loc) ((loc).relNode)
+#endif
+
+/* Covers the ground layer for m up to 32 */
+#define HNSW_SHARED_CACHE_TIDS 64
+#define HNSW_SHARED_CACHE_LOCKS 128
+#define HNSW_SHARED_CACHE_NAME "hnsw shared cache"
+
+/*
+ * Element of the upper layer cache
+ */
+typedef struct HnswUpperElement
+{
+	BlockNumber blkno;
+	OffsetNumber offno;
+	uint8		level;
+	int32	   *neighbors;		/* m slots per layer, -1 if empty */
+	Pointer		value;			/* NULL if not loaded */
+}			HnswUpperElement;
+
+/*
+ * Upper layers of the graph, stored in a single allocation in rd_amcache so
+ * the relcache can free it
+ */
+typedef struct HnswUpperCache
+{
+	uint32		version;
+	uint32		upperVersion;
+	BlockNumber entryBlkno;
+	OffsetNumber entryOffno;
+	int			entryLevel;
+	int			minLevel;
+	int			length;
+	HnswUpperElement elements[FLEXIBLE_ARRAY_MEMBER];
+}			HnswUpperCache;
+
+typedef struct HnswUpperItem
+{
+	BlockNumber blkno;
+	OffsetNumber offno;
+	int			level;
+	Pointer		value;
+	ItemPointerData *indextids;
+	int			ntids;
+}			HnswUpperItem;
+
+/* TID to element index hash table */
+typedef struct HnswUpperTidEntry
+{
+	ItemPointerData tid;
+	int32		index;
+	char		status;
+}			HnswUpperTidEntry;
+
+#define SH_PREFIX		uppertid
+#define SH_ELEMENT_TYPE	HnswUpperTidEntry
+#define SH_KEY_TYPE		ItemPointerData
+#define	SH_KEY			tid
+#define SH_HASH_KEY(tb, key)	hash_bytes((const unsigned char *) &(key), sizeof(ItemPointerData))
+#define SH_EQUAL(tb, a, b)		ItemPointerEquals(&a, &b)
+#define	SH_SCOPE		static inline
+#define SH_DEFINE
+#define SH_DECLARE
+#include "lib/simplehash.h"
+
+/*
+ * Load an upper layer element and its neighbor TIDs for all upper layers
+ */
+static bool
+LoadUpperItem(Relation index, int m, int lc, HnswUpperItem * item)
+{
+	char	   *base = NULL;
+	Buffer		buf;
+	Page		page;
+	HnswElementTuple etup;
+	HnswNeighborTuple ntup;
+	HnswElement element = HnswInitElementFromBlock(item->blkno, item->offno);
+
+	buf = ReadBuffer(index, item->blkno);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buf);
+	etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, item->offno));
+
+	/* Make robust to issues */
+	if (!HnswIsElementTuple(etup) || etup->deleted || etup->level < lc)
+	{
+		UnlockReleaseBuffer(buf);
+		return false;
+	}
+
+	HnswLoadElementFromTuple(element, etup, false, true);
+	UnlockReleaseBuffer(buf);
+
+	item->level = element->level;
+	item->value = DatumGetPointer(HnswGetValue(base, element));
+	item->ntids = element->level * m;
+	item->indextids = palloc(item->ntids * sizeof(ItemPointerData));
+
+	buf = ReadBuffer(index, element->neighborPage);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buf);
+	ntup = (HnswNeighborTuple) PageGetItem(page, PageGetItemId(page, element->neighborOffno));
+
+	/* Layers are stored from highest to lowest */
+	if (ntup->version == element->version && ntup->count == (element->level + 2) * m)
+		memcpy(item->indextids, ntup->indextids, item->ntids * sizeof(ItemPointerData));
+	else
+	{
+		for (int i = 0; i < item->ntids; i++)
+			ItemPointerSetInvalid(&item->indextids[i]);
+	}
+
+	UnlockReleaseBuffer(buf);
+
+	return true;
+}
+
+/*
+ * Add an element to the items if it is not already there
+ */
+static void
+AddUpperItem(uppertid_hash * tids, HnswUpperItem * *items, int *length, int *capacity, ItemPointer indextid)
+{
+	HnswUpperTidEntry *entry;
+	bool		found;
+
+	entry = uppertid_insert(tids, *indextid, &found);
+	if (found)
+		return;
+
+	if (*length == *capacity)
+	{
+		*capacity *= 2;
+		*items = repalloc(*items, *capacity * sizeof(HnswUpperItem));
+	}
+
+	entry->index = *length;
+	(*items)[*length].blkno = ItemPointerGetBlockNumber(indextid);
+	(*items)[*length].offno = ItemPointerGetOffsetNumber(indextid);
+	(*items)[*length].value = NULL;
+	(*items)[*length].level = -1;	/* not loaded */
+	(*length)++;
+}
+
+/*
+ * Build the cache for as many layers as fit into maxSize, or return NULL if
+ * none do
+ *
+ * Layers are read from the top down in a single pass, so when a layer does
+ * not fit, the elements first reached from it are dropped instead of reading
+ * the graph again with fewer layers.
+ */
+static HnswUpperCache *
+BuildUpperCache(Relation index, int m, HnswElement entryPoint, uint32 version, uint32 upperVersion, Size maxSize)
+{
+	MemoryContext tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+												 "Hnsw upper cache temporary context",
+												 ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldCtx = MemoryContextSwitchTo(tmpCtx);
+	uppertid_hash *tids;
+	HnswUpperItem *items;
+	int			capacity = 64;
+	int			length = 0;
+	int			minLevel = entryPoint->level + 1;
+	Size		size = offsetof(HnswUpperCache, elements);
+	Size		elementsSize;
+	Size		neighborsSize = 0;
+	Size		valuesSize = 0;
+	HnswUpperCache *cache = NULL;
+	int32	   *neighbors;
+	char	   *values;
+	ItemPointerData tid;
+
+	tids = uppertid_create(tmpCtx, 256, NULL);
+
+	items = palloc(capacity * sizeof(HnswUpperItem));
+
+	/* Entry point is always the first element */
+	ItemPointerSet(&tid, entryPoint->blkno, entryPoint->offno);
+	AddUpperItem(tids, &items, &length, &capacity, &tid);
+
+	for (int lc = entryPoint->level; lc >= 1; lc--)
+	{
+		int			layerStart = length;
+		Size		layerSize = size;
+		bool		fits;
+
+		/* Elements already cached gain neighbors for this layer */
+		for (int i = 0; i < layerStart; i++)
+		{
+			if (items[i].level >= lc)
+				layerSize += m * sizeof(int32);
+		}
+		fits = layerSize <= maxSize;
+
+		/* Breadth-first search over the layer */
+		for (int i = 0; i < length && fits; i++)
+		{
+			HnswUpperItem *item = &items[i];
+
+			if (item->level == -1)
+			{
+				if (!LoadUpperItem(index, m, lc, item))
+				{
+					item->level = 0;
+					item->ntids = 0;
+					continue;
+				}
+
+				layerSize += sizeof(HnswUpperElement) + MAXALIGN(VARSIZE_ANY(item->value)) + (item->level - lc + 1) * m * sizeof(int32);
+
+				if (layerSize > maxSize)
+				{
+					fits = false;
+					break;
+				}
+			}
+
+			if (item->level < lc)
+				continue;
+
+			/* Layers are stored from highest to lowest */
+			for (int j = 0; j < m; j++)
+			{
+				ItemPointer indextid = &item->indextids[(item->level - lc) * m + j];
+
+				if (ItemPointerIsValid(indextid))
+					AddUpperItem(tids, &items, &length, &capacity, indextid);
+			}
+		}
+
+		/* Drop elements first reached from this layer */
+		if (!fits)
+		{
+			length = layerStart;
+			break;
+		}
+
+		size = layerSize;
+		minLevel = lc;
+	}
+
+	/* Nothing fits */
+	if (minLevel > entryPoint->level)
+	{
+		MemoryContextSwitchTo(oldCtx);
+		MemoryContextDelete(tmpCtx);
+		return NULL;
+	}
+
+	for (int i = 0; i < length; i++)
+	{
+		HnswUpperItem *item = &items[i];
+
+		/* Skip elements that could not be loaded */
+		if (item->level < minLevel)
+		{
+			item->value = NULL;
+			continue;
+		}
+
+		neighborsSize += (item->level - minLevel + 1) * m * sizeof(int32);
+		valuesSize += MAXALIGN(VARSIZE_ANY(item->value));
+	}
+
+	/* Copy to a single allocation */
+	elementsSize = MAXALIGN(offsetof(HnswUpperCache, elements) + length * sizeof(HnswUpperElement));
+	neighborsSize = MAXALIGN(neighborsSize);
+	cache = MemoryContextAlloc(index->rd_indexcxt, elementsSize + neighborsSize + valuesSize);
+	neighbors = (int32 *) ((char *) cache + elementsSize);
+	values = (char *) cache + elementsSize + neighborsSize;
+
+	cache->version = version;
+	cache->upperVersion = upperVersion;
+	cache->entryBlkno = entryPoint->blkno;
+	cache->entryOffno = entryPoint->offno;
+	cache->entryLevel = entryPoint->level;
+	cache->minLevel = minLevel;
+	cache->length = length;
+
+	for (int i = 0; i < length; i++)
+	{
+		HnswUpperItem *item = &items[i];
+		HnswUpperElement *e = &cache->elements[i];
+		int			ntids;
+
+		e->blkno = item->blkno;
+		e->offno = item->offno;
+		e->level = Max(item->level, 0);
+		e->neighbors = neighbors;
+		e->value = NULL;
+
+		if (item->value == NULL)
+			continue;
+
+		ntids = (item->level - minLevel + 1) * m;
+
+		for (int j = 0; j < ntids; j++)
+		{
+			ItemPointer indextid = &item->indextids[j];
+			HnswUpperTidEntry *entry = NULL;
+
+			if (ItemPointerIsValid(indextid))
+				entry = uppertid_lookup(tids, *indextid);
+
+			/* Elements dropped with a layer are not cached */
+			if (entry != NULL && entry->index < length)
+				neighbors[j] = entry->index;
+			else
+				neighbors[j] = -1;
+		}
+		neighbors += ntids;
+
+		memcpy(values, item->value, VARSIZE_ANY(item->value));
+		e->value = values;
+		values += MAXALIGN(VARSIZE_ANY(item->value));
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextDelete(tmpCtx);
+
+	return cache;
+}
+
+/*
+ * Get the cache, rebuilding it if the graph has changed
+ */
+static HnswUpperCache *
+GetUpperCache(Relation index, int m, HnswElement entryPoint, uint32 version, uint32 upperVersion)
+{
+	HnswUpperCache *cache = (HnswUpperCache *) index->rd_amcache;
+	Size		maxSize = (Size) hnsw_upper_cache_size * 1024;
+
+	if (cache != NULL && cache->version == version && cache->upperVersion == upperVersion && cache->entryBlkno == entryPoint->blkno && cache->entryOffno == entryPoint->offno && cache->entryLevel == entryPoint->level)
+		return cache;
+
+	if (cache != NULL)
+	{
+		pfree(cache);
+		index->rd_amcache = NULL;
+	}
+
+	/* Cache as many layers as fit */
+	cache = BuildUpperCache(index, m, entryPoint, version, upperVersion, maxSize);
+
+	/* Remember that nothing fits */
+	if (cache == NULL)
+	{
+		cache = MemoryContextAlloc(index->rd_indexcxt, offsetof(HnswUpperCache, elements));
+		cache->version = version;
+		cache->upperVersion = upperVersion;
+		cache->entryBlkno = entryPoint->blkno;
+		cache->entryOffno = entryPoint->offno;
+		cache->entryLevel = entryPoint->level;
+		cache->minLevel = entryPoint->level + 1;
+		cache->length = 0;
+	}
+
+	index->rd_amcache = cache;
+
+	return cache;
+}
+
+/*
+ * Search the cached upper layers in memory and return the entry point for
+ * the highest uncached layer, which is stored in level
+ */
+HnswElement
+HnswSearchUpperCache(Relation index, HnswQuery * q, HnswSupport * support, int m, HnswElement entryPoint, int *level)
+{
+	HnswUpperCache *cache;
+	HnswUpperElement *cur;
+	double		curDistance;
+	HnswElement element;
+
+	*level = entryPoint->level;
+
+	if (hnsw_upper_cache_size == 0 || entryPoint->level < 1 || DatumGetPointer(q->value) == NULL)
+		return entryPoint;
+
+	cache = GetUpperCache(index, m, entryPoint, q->cacheVersion, q->upperVersion);
+	if (cache->length == 0 || cache->elements[0].value == NULL)
+		return entryPoint;
+
+	cur = &cache->elements[0];
+	curDistance = HnswGetDistance(q->value, PointerGetDatum(cur->value), support);
+
+	/* Greedy search, which is the same as a search layer with ef = 1 */
+	for (int lc = cache->entryLevel; lc >= cache->minLevel; lc--)
+	{
+		bool		changed = true;
+
+		while (changed)
+		{
+			int32	   *neighbors = cur->neighbors + (cur->level - lc) * m;
+
+			changed = false;
+
+			for (int i = 0; i < m; i++)
+			{
+				HnswUpperElement *e;
+				double		distance;
+
+				if (neighbors[i] < 0)
+					continue;
+
+				e = &cache->elements[neighbors[i]];
+
+				/* Make robust to issues */
+				if (e->value == NULL || e->level < lc)
+					continue;
+
+				distance = HnswGetDistance(q->value, PointerGetDatum(e->value), support);
+				if (distance < curDistance)
+				{
+					cur = e;
+					curDistance = distance;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	element = HnswInitElementFromBlock(cur->blkno, cur->offno);
+	element->level = cur->level;
+	*level = cache->minLevel - 1;
+
+	return element;
+}
+
+/*
+ * Increment a version on the metapage
+ */
+static void
+IncrementMetaPageVersion(Relation index, bool upper)
+{
+	Buffer		buf;
+	Page		page;
+	GenericXLogState *state;
+	HnswMetaPage metap;
+
+	buf = ReadBuffer(index, HNSW_METAPAGE_BLKNO);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	state = GenericXLogStart(index);
+	page = GenericXLogRegisterBuffer(state, buf, 0);
+	metap = HnswPageGetMeta(page);
+
+	HnswUpgradeMetaPage(page);
+
+	if (upper)
+		metap->upperVersion++;
+	else
+		metap->cacheVersion++;
+
+	GenericXLogFinish(state);
+	UnlockReleaseBuffer(buf);
+}
+
+/*
+ * Set cache versions on metapages of indexes created before 0.8.1, which are
+ * shorter. Scans skip the shared cache for these until a write upgrades them.
+ * The cache version is random so lists cached for a dropped index do not
+ * match another index that reuses its relfilenode.
+ */
+void
+HnswUpgradeMetaPage(Page page)
+{
+	HnswMetaPage metap = HnswPageGetMeta(page);
+
+	if (((PageHeader) page)->pd_lower >= HnswMetaPageLower(page))
+		return;
+
+	metap->cacheVersion = RandomInt();
+	metap->upperVersion = 0;
+	((PageHeader) page)->pd_lower = HnswMetaPageLower(page);
+}
+
+/*
+ * Invalidate cached graph data in all backends
+ */
+void
+HnswInvalidateCache(Relation index)
+{
+	IncrementMetaPageVersion(index, false);
+}
+
+/*
+ * Invalidate cached upper layers in all backends after an insert adds to them
+ */
+void
+HnswInvalidateUpperCache(Relation index)
+{
+	IncrementMetaPageVersion(index, true);
+}
+
+/*
+ * Neighbor list of an element in a layer, stored in shared memory
+ */
+typedef struct HnswSharedCacheKey
+{
+	Oid			spcOid;
+	Oid			dbOid;
+	Oid			relNumber;
+	BlockNumber blkno;
+	OffsetNumber offno;
+	uint16		lc;
+}			HnswSharedCacheKey;
+
+typedef struct HnswSharedCacheSlot
+{
+	HnswSharedCacheKey key;
+	XLogRecPtr	lsn;			/* neighbor page LSN if cached during recovery */
+	uint32		cacheVersion;
+	uint8		version;
+	uint8		length;			/* 0 if empty */
+	ItemPointerData indextids[HNSW_SHARED_CACHE_TIDS];
+}			HnswSharedCacheSlot;
+
+typedef struct HnswSharedCache
+{
+	uint32		nslots;
+	HnswSharedCacheSlot slots[FLEXIBLE_ARRAY_MEMBER];
+}			HnswSharedCache;
+
+static HnswSharedCache * hnswSharedCache = NULL;
+static LWLockPadded *hnswSharedCacheLocks = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+
+/*
+ * Get the number of slots for the configured size
+ */
+static uint32
+HnswSharedCacheSlots(void)
+{
+	return Max((Size) hnsw_shared_cache_size * 1024 / sizeof(HnswSharedCacheSlot), 1);
+}
+
+/*
+ * Get the shared memory size
+ */
+static Size
+HnswSharedCacheShmemSize(void)
+{
+	return add_size(offsetof(HnswSharedCache, slots), mul_size(HnswSharedCacheSlots(), sizeof(HnswSharedCacheSlot)));
+}
+
+/*
+ * Request shared memory and locks
+ */
+static void
+HnswSharedCacheShmemRequest(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(HnswSharedCacheShmemSize());
+	RequestNamedLWLockTranche(HNSW_SHARED_CACHE_NAME, HNSW_SHARED_CACHE_LOCKS);
+}
+
+/*
+ * Attach to shared memory, initializing it if needed
+ */
+static void
+HnswSharedCacheShmemStartup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	hnswSharedCache = ShmemInitStruct(HNSW_SHARED_CACHE_NAME, HnswSharedCacheShmemSize(), &found);
+	if (!found)
+	{
+		MemSet(hnswSharedCache, 0, HnswSharedCacheShmemSize());
+		hnswSharedCache->nslots = HnswSharedCacheSlots();
+	}
+
+	hnswSharedCacheLocks = GetNamedLWLockTranche(HNSW_SHARED_CACHE_NAME);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Reserve shared memory when loaded with shared_preload_libraries
+ */
+void
+HnswInitSharedCache(void)
+{
+	if (!process_shared_preload_libraries_in_progress || hnsw_shared_cache_size == 0)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = HnswSharedCacheShmemRequest;
+#else
+	HnswSharedCacheShmemRequest();
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = HnswSharedCacheShmemStartup;
+}
+
+/*
+ * Find the slot and lock for a neighbor list
+ */
+static HnswSharedCacheSlot *
+HnswSharedCacheFind(Relation index, HnswElement element, int lc, HnswSharedCacheKey * key, LWLock **lock)
+{
+	uint32		slotno;
+
+	/* Zero padding so the key can be hashed and compared as bytes */
+	MemSet(key, 0, sizeof(HnswSharedCacheKey));
+	key->spcOid = HnswRelFileSpc(HnswRelFileLocator(index));
+	key->dbOid = HnswRelFileDb(HnswRelFileLocator(index));
+	key->relNumber = HnswRelFileRel(HnswRelFileLocator(index));
+	key->blkno = element->blkno;
+	key->offno = element->offno;
+	key->lc = lc;
+
+	slotno = hash_bytes((const unsigned char *) key, sizeof(HnswSharedCacheKey)) % hnswSharedCache->nslots;
+	*lock = &hnswSharedCacheLocks[slotno % HNSW_SHARED_CACHE_LOCKS].lock;
+
+	return &hnswSharedCache->slots[slotno];
+}
+
+/*
+ * Copy a cached neighbor list, returning false if it is not cached
+ */
+bool
+HnswSharedCacheGet(Relation index, HnswElement element, int lc, uint32 cacheVersion, ItemPointerData *indextids, int lm)
+{
+	HnswSharedCacheKey key;
+	HnswSharedCacheSlot *slot;
+	LWLock	   *lock;
+	bool		found = false;
+
+	XLogRecPtr	lsn = InvalidXLogRecPtr;
+
+	if (hnswSharedCache == NULL || lm > HNSW_SHARED_CACHE_TIDS)
+		return false;
+
+	slot = HnswSharedCacheFind(index, element, lc, &key, &lock);
+
+	LWLockAcquire(lock, LW_SHARED);
+	if (slot->length == lm && slot->version == element->version && slot->cacheVersion == cacheVersion && memcmp(&slot->key, &key, sizeof(HnswSharedCacheKey)) == 0)
+	{
+		memcpy(indextids, slot->indextids, lm * sizeof(ItemPointerData));
+		lsn = slot->lsn;
+		found = true;
+	}
+	LWLockRelease(lock);
+
+	/*
+	 * Replaying inserts does not invalidate cached lists, so lists cached
+	 * during recovery are checked against the page, which only needs a pin
+	 */
+	if (found && !XLogRecPtrIsInvalid(lsn))
+	{
+		Buffer		buf = ReadBuffer(index, element->neighborPage);
+
+		found = BufferGetLSNAtomic(buf) == lsn;
+		ReleaseBuffer(buf);
+	}
+
+	return found;
+}
+
+/*
+ * Cache a neighbor list. The caller must hold a lock on the neighbor page so
+ * the list cannot be updated concurrently.
+ */
+void
+HnswSharedCachePut(Relation index, HnswElement element, int lc, uint32 cacheVersion, ItemPointerData *indextids, int lm, XLogRecPtr lsn)
+{
+	HnswSharedCacheKey key;
+	HnswSharedCacheSlot *slot;
+	LWLock	   *lock;
+	bool		recovery = RecoveryInProgress();
+
+	if (hnswSharedCache == NULL || lm > HNSW_SHARED_CACHE_TIDS)
+		return;
+
+	/* Lists cached during recovery can only be checked with the page LSN */
+	if (recovery && XLogRecPtrIsInvalid(lsn))
+		return;
+
+	slot = HnswSharedCacheFind(index, element, lc, &key, &lock);
+
+	/* Skip rather than wait, since the list can be read from the page */
+	if (!LWLockConditionalAcquire(lock, LW_EXCLUSIVE))
+		return;
+
+	slot->key = key;
+	slot->lsn = recovery ? lsn : InvalidXLogRecPtr;
+	slot->cacheVersion = cacheVersion;
+	slot->version = element->version;
+	slot->length = lm;
+	memcpy(slot->indextids, indextids, lm * sizeof(ItemPointerData));
+	LWLockRelease(lock);
+}
+
+/*
+ * Remove a neighbor list after it is updated. The caller must hold an
+ * exclusive lock on the neighbor page.
+ */
+void
+HnswSharedCacheInvalidate(Relation index, HnswElement element, int lc)
+{
+	HnswSharedCacheKey key;
+	HnswSharedCacheSlot *slot;
+	LWLock	   *lock;
+
+	if (hnswSharedCache == NULL)
+		return;
+
+	slot = HnswSharedCacheFind(index, element, lc, &key, &lock);
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	if (memcmp(&slot->key, &key, sizeof(HnswSharedCacheKey)) == 0)
+		slot->length = 0;
+	LWLockRelease(lock);
+}
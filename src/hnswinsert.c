@@ -156,9 +156,11 @@ AddElementOnDisk(Relation index, HnswElement e, int m, BlockNumber insertPage, B
 	BlockNumber newInsertPage = InvalidBlockNumber;
 	uint8		tupleVersion;
 	char	   *base = NULL;
+	bool		sq8 = HnswUseSq8(index);
+	bool		attrs = HnswHasAttrs(index);
 
 	/* Calculate sizes */
-	etupSize = HNSW_ELEMENT_TUPLE_SIZE(VARSIZE_ANY(HnswPtrAccess(base, e->value)));
+	etupSize = HNSW_ELEMENT_TUPLE_SIZE(HnswElementDataSize(HnswPtrAccess(base, e->value), sq8, attrs));
 	ntupSize = HNSW_NEIGHBOR_TUPLE_SIZE(e->level, m);
 	combinedSize = etupSize + ntupSize + sizeof(ItemIdData);
 	maxSize = HNSW_MAX_SIZE;
@@ -166,7 +168,7 @@ AddElementOnDisk(Relation index, HnswElement e, int m, BlockNumber insertPage, B
 
 	/* Prepare element tuple */
 	etup = palloc0(etupSize);
-	HnswSetElementTuple(base, etup, e);
+	HnswSetElementTuple(base, etup, e, sq8, attrs);
 
 	/* Prepare neighbor tuple */
 	ntup = palloc0(ntupSize);
@@ -350,7 +352,7 @@ HnswLoadNeighbors(HnswElement element, Relation index, int m, int lm, int lc)
 	HnswNeighborArray *neighbors = HnswInitNeighborArray(lm, NULL);
 	ItemPointerData indextids[HNSW_MAX_M * 2];
 
-	if (!HnswLoadNeighborTids(element, indextids, index, m, lm, lc))
+	if (!HnswLoadNeighborTids(element, indextids, index, m, lm, lc, NULL))
 		return neighbors;
 
 	for (int i = 0; i < lm; i++)
@@ -428,6 +430,7 @@ GetUpdateIndex(HnswElement element, HnswElement newElement, float distance, int
 		HnswQuery	q;
 
 		q.value = HnswGetValue(base, element);
+		q.nkeys = 0;
 
 		LoadElementsForInsert(neighbors, &q, &idx, index, support);
 
@@ -521,6 +524,12 @@ UpdateNeighborOnDisk(HnswElement element, HnswElement newElement, int idx, int m
 		/* Update neighbor on the buffer */
 		ItemPointerSet(indextid, newElement->blkno, newElement->offno);
 
+		/* Scans in other backends must see the new connection */
+		if (!building)
+			HnswSharedCacheInvalidate(index, element, lc);
+
+		IndexStatsCount(INDEX_STATS_NEIGHBOR_UPDATES, 1);
+
 		/* Commit */
 		if (building)
 			MarkBufferDirty(buf);
@@ -638,6 +647,7 @@ FindDuplicateOnDisk(Relation index, HnswElement element, bool building)
 	char	   *base = NULL;
 	HnswNeighborArray *neighbors = HnswGetNeighbors(base, element, 0);
 	Datum		value = HnswGetValue(base, element);
+	bool		attrs = HnswHasAttrs(index);
 
 	for (int i = 0; i < neighbors->length; i++)
 	{
@@ -649,6 +659,10 @@ FindDuplicateOnDisk(Relation index, HnswElement element, bool building)
 		if (!datumIsEqual(value, neighborValue, false, -1))
 			return false;
 
+		/* Other columns must match as well */
+		if (attrs && !HnswAttrsEqual(value, neighborValue))
+			continue;
+
 		if (AddDuplicateOnDisk(index, element, neighborElement, building))
 			return true;
 	}
@@ -681,6 +695,23 @@ UpdateGraphOnDisk(Relation index, HnswSupport * support, HnswElement element, in
 	/* Update entry point if needed */
 	if (entryPoint == NULL || element->level > entryPoint->level)
 		HnswUpdateMetaPage(index, HNSW_UPDATE_ENTRY_GREATER, element, InvalidBlockNumber, MAIN_FORKNUM, building);
+
+	/* Upper layers cached by scans no longer match the graph */
+	if (element->level > 0 && !building)
+		HnswInvalidateUpperCache(index);
+}
+
+/*
+ * Lock the update page, counting waits
+ */
+static void
+LockUpdatePage(Relation index, LOCKMODE lockmode)
+{
+	if (ConditionalLockPage(index, HNSW_UPDATE_LOCK, lockmode))
+		return;
+
+	IndexStatsCount(INDEX_STATS_LOCK_WAITS, 1);
+	LockPage(index, HNSW_UPDATE_LOCK, lockmode);
 }
 
 /*
@@ -701,10 +732,10 @@ HnswInsertTupleOnDisk(Relation index, HnswSupport * support, Datum value, ItemPo
 	 * before repairing graph. Use a page lock so it does not interfere with
 	 * buffer lock (or reads when vacuuming).
 	 */
-	LockPage(index, HNSW_UPDATE_LOCK, lockmode);
+	LockUpdatePage(index, lockmode);
 
 	/* Get m and entry point */
-	HnswGetMetaPageInfo(index, &m, &entryPoint);
+	HnswGetMetaPageInfo(index, &m, &entryPoint, NULL, NULL);
 
 	/* Create an element */
 	element = HnswInitElement(base, heaptid, m, HnswGetMl(m), HnswGetMaxLevel(m), NULL);
@@ -718,14 +749,14 @@ HnswInsertTupleOnDisk(Relation index, HnswSupport * support, Datum value, ItemPo
 
 		/* Get exclusive lock */
 		lockmode = ExclusiveLock;
-		LockPage(index, HNSW_UPDATE_LOCK, lockmode);
+		LockUpdatePage(index, lockmode);
 
 		/* Get latest entry point after lock is acquired */
 		entryPoint = HnswGetEntryPoint(index);
 	}
 
 	/* Find neighbors for element */
-	HnswFindElementNeighbors(base, element, entryPoint, index, support, m, efConstruction, false);
+	HnswFindElementNeighbors(base, element, entryPoint, index, support, m, efConstruction, false, NULL);
 
 	/* Update graph on disk */
 	UpdateGraphOnDisk(index, support, element, m, efConstruction, entryPoint, building);
@@ -752,6 +783,10 @@ HnswInsertTuple(Relation index, Datum *values, bool *isnull, ItemPointer heaptid
 	if (!HnswFormIndexValue(&value, values, isnull, typeInfo, &support))
 		return;
 
+	/* Store other columns with the value */
+	if (HnswHasAttrs(index))
+		value = HnswAppendAttrs(index, value, values, isnull);
+
 	HnswInsertTupleOnDisk(index, &support, value, heaptid, false);
 }
 
@@ -769,6 +804,8 @@ hnswinsert(Relation index, Datum *values, bool *isnull, ItemPointer heap_tid,
 {
 	MemoryContext oldCtx;
 	MemoryContext insertCtx;
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts;
 
 	/* Skip nulls */
 	if (isnull[0])
@@ -781,7 +818,11 @@ hnswinsert(Relation index, Datum *values, bool *isnull, ItemPointer heap_tid,
 	oldCtx = MemoryContextSwitchTo(insertCtx);
 
 	/* Insert tuple */
+	prevCounts = IndexStatsBegin(&counts);
 	HnswInsertTuple(index, values, isnull, heap_tid);
+	IndexStatsEnd(prevCounts);
+
+	IndexStatsFlush(index, &counts);
 
 	/* Delete memory context */
 	MemoryContextSwitchTo(oldCtx);
@@ -1,47 +1,212 @@
 #include "postgres.h"
 
+#include <math.h>
+
+#include "access/htup_details.h"
 #include "access/relscan.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "catalog/index.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "executor/executor.h"
+#include "executor/tuptable.h"
+#include "fmgr.h"
+#include "funcapi.h"
 #include "hnsw.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/paths.h"
+#include "optimizer/restrictinfo.h"
 #include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/float.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/tuplestore.h"
+#include "utils/typcache.h"
+
+/* Bounds of a scan from its LIMIT, found by its ORDER BY keys */
+typedef struct HnswScanBounds
+{
+	ScanKey		orderbys;
+	int64		limit;
+	EState	   *estate;
+	struct HnswScanBounds *next;
+}			HnswScanBounds;
+
+static HnswScanBounds * scanBounds = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static set_rel_pathlist_hook_type prev_set_rel_pathlist = NULL;
 
 /*
  * Algorithm 5 from paper
  */
 static List *
+SearchGraph(Relation index, HnswQuery * q, HnswSupport * support, int m, HnswElement entryPoint, int ef, visited_hash * v, pairingheap **discarded, int64 *tuples)
+{
+	List	   *ep;
+	List	   *w;
+	int			level;
+	char	   *base = NULL;
+
+	/* Skip upper layers cached in memory, except when tracing them */
+	if (q->trace == NULL)
+		entryPoint = HnswSearchUpperCache(index, q, support, m, entryPoint, &level);
+	else
+		level = entryPoint->level;
+
+	ep = list_make1(HnswEntryCandidate(base, entryPoint, q, index, support, false));
+
+	for (int lc = level; lc >= 1; lc--)
+	{
+		w = HnswSearchLayer(base, q, ep, 1, lc, index, support, m, false, NULL, NULL, NULL, true, NULL);
+		ep = w;
+	}
+
+	return HnswSearchLayer(base, q, ep, ef, 0, index, support, m, false, NULL, v, discarded, true, tuples);
+}
+
+/*
+ * Get the size of the dynamic candidate list for the first iteration
+ */
+static int
+GetEfSearch(HnswScanOpaque so)
+{
+	double		ef;
+
+	if (hnsw_ef_search_factor == 0 || so->limit <= 0)
+		return hnsw_ef_search;
+
+	/* Replaces hnsw.ef_search, but keeps at least as many candidates as rows */
+	ef = Max(ceil(so->limit * hnsw_ef_search_factor), so->limit);
+	return (int) Min(ef, HNSW_MAX_EF_SEARCH);
+}
+
+/*
+ * Compare search candidate distances, farthest first
+ */
+static int
+CompareSearchCandidateDistances(const ListCell *a, const ListCell *b)
+{
+	HnswSearchCandidate *sca = lfirst(a);
+	HnswSearchCandidate *scb = lfirst(b);
+
+	if (sca->distance < scb->distance)
+		return 1;
+
+	if (sca->distance > scb->distance)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Replace distances to 8-bit codes with lower bounds of the distances to the
+ * original vectors, which the executor needs in order
+ */
+static List *
+SetLowerBounds(HnswScanOpaque so, List *w)
+{
+	char	   *base = NULL;
+	ListCell   *lc;
+
+	if (!so->sq8)
+		return w;
+
+	foreach(lc, w)
+	{
+		HnswSearchCandidate *sc = lfirst(lc);
+		HnswElement element = HnswPtrAccess(base, sc->element);
+
+		sc->distance = HnswGetSq8LowerBound(&so->support, so->q.value, so->sq8Factor, sc->distance, element->sq8Error);
+	}
+
+	list_sort(w, CompareSearchCandidateDistances);
+	return w;
+}
+
+/*
+ * Get items for the first iteration of a scan
+ */
+static List *
 GetScanItems(IndexScanDesc scan, Datum value)
 {
 	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
 	Relation	index = scan->indexRelation;
-	HnswSupport *support = &so->support;
-	List	   *ep;
-	List	   *w;
 	int			m;
 	HnswElement entryPoint;
-	char	   *base = NULL;
 	HnswQuery  *q = &so->q;
 
 	/* Get m and entry point */
-	HnswGetMetaPageInfo(index, &m, &entryPoint);
+	q->sharedCache = HnswGetMetaPageInfo(index, &m, &entryPoint, &q->cacheVersion, &q->upperVersion);
 
 	q->value = value;
+	q->tupdesc = RelationGetDescr(index);
+	q->keys = so->keys;
+	q->nkeys = so->nkeys;
+	q->limit = so->limit;
+	q->trace = NULL;
 	so->m = m;
 
+	/* Quantized distances are approximate, so leave the radius to the qual */
+	if (so->sq8)
+	{
+		q->maxDistance = get_float8_infinity();
+		so->sq8Factor = HnswGetSq8ErrorFactor(&so->support, value);
+	}
+	else
+	{
+		q->maxDistance = HnswGetIndexDistance(so->distanceType, so->radius);
+
+		/*
+		 * Index distances can be below the operator from rounding, so only
+		 * stop past the radius and leave the rows at the boundary to the qual
+		 */
+		q->maxDistance += HnswGetDistanceEpsilon(&so->support, so->distanceType, TupleDescAttr(RelationGetDescr(index), 0)->atttypmod, q->maxDistance);
+	}
+
 	if (entryPoint == NULL)
 		return NIL;
 
-	ep = list_make1(HnswEntryCandidate(base, entryPoint, q, index, support, false));
+	return SetLowerBounds(so, SearchGraph(index, q, &so->support, m, entryPoint, GetEfSearch(so), &so->v, hnsw_iterative_scan != HNSW_ITERATIVE_SCAN_OFF ? &so->discarded : NULL, &so->tuples));
+}
+
+/*
+ * Load the element of a candidate discarded without it
+ */
+static bool
+LoadCandidate(IndexScanDesc scan, HnswSearchCandidate * sc)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+	char	   *base = NULL;
+	HnswElement element;
+
+	if (!HnswPtrIsNull(base, sc->element))
+		return true;
+
+	element = HnswInitElementFromBlock(sc->blkno, sc->offno);
+	HnswLoadElement(element, NULL, &so->q, scan->indexRelation, &so->support, false, NULL);
 
-	for (int lc = entryPoint->level; lc >= 1; lc--)
+	/* Element was replaced after it was discarded */
+	if (element->version != sc->version)
 	{
-		w = HnswSearchLayer(base, q, ep, 1, lc, index, support, m, false, NULL, NULL, NULL, true, NULL);
-		ep = w;
+		pfree(element);
+		return false;
 	}
 
-	return HnswSearchLayer(base, q, ep, hnsw_ef_search, 0, index, support, m, false, NULL, &so->v, hnsw_iterative_scan != HNSW_ITERATIVE_SCAN_OFF ? &so->discarded : NULL, true, &so->tuples);
+	HnswPtrStore(base, sc->element, element);
+	return true;
 }
 
 /*
@@ -53,14 +218,21 @@ ResumeScanItems(IndexScanDesc scan)
 	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
 	Relation	index = scan->indexRelation;
 	List	   *ep = NIL;
+	List	   *w;
 	char	   *base = NULL;
 	int			batch_size = hnsw_ef_search;
 
 	if (pairingheap_is_empty(so->discarded))
 		return NIL;
 
+	/* Remaining candidates are outside the radius */
+	if (HnswGetSearchCandidate(w_node, pairingheap_first(so->discarded))->distance > so->q.maxDistance)
+		return NIL;
+
+	IndexStatsCount(INDEX_STATS_RESUMES, 1);
+
 	/* Get next batch of candidates */
-	for (int i = 0; i < batch_size; i++)
+	while (list_length(ep) < batch_size)
 	{
 		HnswSearchCandidate *sc;
 
@@ -69,10 +241,21 @@ ResumeScanItems(IndexScanDesc scan)
 
 		sc = HnswGetSearchCandidate(w_node, pairingheap_remove_first(so->discarded));
 
+		if (!LoadCandidate(scan, sc))
+		{
+			pfree(sc);
+			continue;
+		}
+
 		ep = lappend(ep, sc);
 	}
 
-	return HnswSearchLayer(base, &so->q, ep, batch_size, 0, index, &so->support, so->m, false, NULL, &so->v, &so->discarded, false, &so->tuples);
+	w = HnswSearchLayer(base, &so->q, ep, batch_size, 0, index, &so->support, so->m, false, NULL, &so->v, &so->discarded, false, &so->tuples);
+
+	/* Entry candidates are not part of the results */
+	list_free_deep(ep);
+
+	return SetLowerBounds(so, w);
 }
 
 /*
@@ -113,6 +296,147 @@ ShowMemoryUsage(HnswScanOpaque so)
 }
 #endif
 
+/*
+ * Form a tuple with the stored columns for index-only scans
+ */
+static bool
+FetchReturnTuple(IndexScanDesc scan, HnswElement element, ItemPointer heaptid)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+	Relation	index = scan->indexRelation;
+	TupleDesc	tupdesc = RelationGetDescr(index);
+	Datum	   *values;
+	bool	   *isnull;
+	Buffer		buf;
+	Page		page;
+	HnswElementTuple etup;
+	bool		found = false;
+	MemoryContext oldCtx;
+
+	MemoryContextReset(so->tupleCtx);
+	oldCtx = MemoryContextSwitchTo(so->tupleCtx);
+
+	values = palloc(tupdesc->natts * sizeof(Datum));
+	isnull = palloc(tupdesc->natts * sizeof(bool));
+
+	buf = ReadBuffer(index, element->blkno);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
+	page = BufferGetPage(buf);
+	etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, element->offno));
+
+	/* Check the element was not replaced */
+	if (HnswIsElementTuple(etup) && !etup->deleted && etup->version == element->version)
+	{
+		for (int i = 0; i < HNSW_HEAPTIDS; i++)
+		{
+			if (ItemPointerEquals(&etup->heaptids[i], heaptid))
+			{
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if (found)
+	{
+		if (etup->flags & HNSW_ELEMENT_ATTRS)
+			index_deform_tuple(HnswElementTupleAttrs(etup), tupdesc, values, isnull);
+		else
+			memset(isnull, true, tupdesc->natts * sizeof(bool));
+
+		/* Value is only returned when stored as-is */
+		values[0] = PointerGetDatum(&etup->data);
+		isnull[0] = !so->returnValue;
+
+		/* Copy before releasing the buffer */
+		scan->xs_hitup = heap_form_tuple(tupdesc, values, isnull);
+		scan->xs_hitupdesc = tupdesc;
+	}
+
+	UnlockReleaseBuffer(buf);
+
+	MemoryContextSwitchTo(oldCtx);
+
+	return found;
+}
+
+/*
+ * Get the query, radius, and distance operator of a range, returning false if
+ * any are null
+ */
+static bool
+GetRange(Datum range, Oid type, Datum *query, double *radius, Oid *operator)
+{
+	HeapTupleHeader th = DatumGetHeapTupleHeader(range);
+	TupleDesc	tupdesc = lookup_rowtype_tupdesc(HeapTupleHeaderGetTypeId(th), HeapTupleHeaderGetTypMod(th));
+	HeapTupleData tuple;
+	Datum		values[3];
+	bool		isnull[3];
+	Oid			lefttype;
+	Oid			righttype;
+
+	if (tupdesc->natts != 3 ||
+		TupleDescAttr(tupdesc, 0)->atttypid != type ||
+		TupleDescAttr(tupdesc, 1)->atttypid != FLOAT8OID ||
+		TupleDescAttr(tupdesc, 2)->atttypid != REGOPERATOROID)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("range must have a %s query, a float8 radius, and a distance operator", format_type_be(type))));
+
+	tuple.t_len = HeapTupleHeaderGetDatumLength(th);
+	ItemPointerSetInvalid(&tuple.t_self);
+	tuple.t_tableOid = InvalidOid;
+	tuple.t_data = th;
+	heap_deform_tuple(&tuple, tupdesc, values, isnull);
+	ReleaseTupleDesc(tupdesc);
+
+	if (isnull[0] || isnull[1] || isnull[2])
+		return false;
+
+	*query = values[0];
+	*radius = DatumGetFloat8(values[1]);
+	*operator = DatumGetObjectId(values[2]);
+
+	op_input_types(*operator, &lefttype, &righttype);
+	if (lefttype != type || righttype != type || get_op_rettype(*operator) != FLOAT8OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("range operator must return the distance between two %s values", format_type_be(type))));
+
+	return true;
+}
+
+/*
+ * Get the radius of a range key, or infinity if it does not bound distances
+ * from the ORDER BY value
+ */
+static double
+GetRangeRadius(IndexScanDesc scan, ScanKey key)
+{
+	Relation	index = scan->indexRelation;
+	ScanKey		orderby = scan->orderByData;
+	Oid			type = index->rd_opcintype[0];
+	Datum		query;
+	double		radius;
+	Oid			operator;
+
+	if ((key->sk_flags & SK_ISNULL) || orderby == NULL || (orderby->sk_flags & SK_ISNULL))
+		return get_float8_infinity();
+
+	if (!GetRange(key->sk_argument, type, &query, &radius, &operator) || isnan(radius))
+		return get_float8_infinity();
+
+	/* Only ranges of the ORDER BY operator and value bound the search */
+	if (operator != get_opfamily_member(index->rd_opfamily[0], type, type, 1))
+		return get_float8_infinity();
+
+	if (!datumIsEqual(PointerGetDatum(PG_DETOAST_DATUM(query)), PointerGetDatum(PG_DETOAST_DATUM(orderby->sk_argument)), false, -1))
+		return get_float8_infinity();
+
+	return radius;
+}
+
 /*
  * Prepare for an index scan
  */
@@ -130,6 +454,14 @@ hnswbeginscan(Relation index, int nkeys, int norderbys)
 
 	/* Set support functions */
 	HnswInitSupport(&so->support, index);
+	so->distanceType = HnswGetDistanceType(&so->support);
+	so->sq8 = HnswUseSq8(index);
+	so->sq8Factor = 0;
+	so->limit = 0;
+	so->radius = get_float8_infinity();
+	MemSet(&so->counts, 0, sizeof(IndexStatsCounts));
+	so->keys = nkeys > 0 ? palloc(nkeys * sizeof(ScanKeyData)) : NULL;
+	so->nkeys = 0;
 
 	/*
 	 * Use a lower max allocation size than default to allow scanning more
@@ -144,6 +476,12 @@ hnswbeginscan(Relation index, int nkeys, int norderbys)
 	maxMemory = (double) work_mem * hnsw_scan_mem_multiplier * 1024.0 + 256;
 	so->maxMemory = Min(maxMemory, (double) SIZE_MAX);
 
+	/* Tuples for index-only scans only need to live until the next call */
+	so->returnValue = hnswcanreturn(index, 1);
+	so->tupleCtx = AllocSetContextCreate(CurrentMemoryContext,
+										 "Hnsw scan tuple context",
+										 ALLOCSET_SMALL_SIZES);
+
 	scan->opaque = so;
 
 	return scan;
@@ -163,13 +501,38 @@ hnswrescan(IndexScanDesc scan, ScanKey keys, int nkeys, ScanKey orderbys, int no
 	so->discarded = NULL;
 	so->tuples = 0;
 	so->previousDistance = -get_float8_infinity();
+	so->limit = 0;
+	so->radius = get_float8_infinity();
+	so->cutoff = false;
 	MemoryContextReset(so->tmpCtx);
 
+	/* Executor passes the same keys on each rescan */
+	for (HnswScanBounds * sb = scanBounds; sb != NULL; sb = sb->next)
+	{
+		if (orderbys != NULL && sb->orderbys == orderbys)
+		{
+			so->limit = sb->limit;
+			break;
+		}
+	}
+
 	if (keys && scan->numberOfKeys > 0)
 		memmove(scan->keyData, keys, scan->numberOfKeys * sizeof(ScanKeyData));
 
 	if (orderbys && scan->numberOfOrderBys > 0)
 		memmove(scan->orderByData, orderbys, scan->numberOfOrderBys * sizeof(ScanKeyData));
+
+	/* Range keys bound the search, and other keys filter elements */
+	so->nkeys = 0;
+	for (int i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey		key = &scan->keyData[i];
+
+		if (key->sk_attno == 1 && key->sk_strategy == HNSW_RANGE_STRATEGY)
+			so->radius = Min(so->radius, GetRangeRadius(scan, key));
+		else
+			so->keys[so->nkeys++] = *key;
+	}
 }
 
 /*
@@ -180,6 +543,7 @@ hnswgettuple(IndexScanDesc scan, ScanDirection dir)
 {
 	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
 	MemoryContext oldCtx = MemoryContextSwitchTo(so->tmpCtx);
+	IndexStatsCounts *prevCounts = IndexStatsBegin(&so->counts);
 
 	/*
 	 * Index can be used to scan backward, but Postgres doesn't support
@@ -230,6 +594,7 @@ hnswgettuple(IndexScanDesc scan, ScanDirection dir)
 		HnswSearchCandidate *sc;
 		HnswElement element;
 		ItemPointer heaptid;
+		bool		loaded;
 
 		if (list_length(so->w) == 0)
 		{
@@ -243,11 +608,35 @@ hnswgettuple(IndexScanDesc scan, ScanDirection dir)
 			/* Reached max number of tuples or memory limit */
 			if (so->tuples >= hnsw_max_scan_tuples || MemoryContextMemAllocated(so->tmpCtx, false) > so->maxMemory)
 			{
+				/* Count once per scan */
+				if (!so->cutoff)
+				{
+					IndexStatsCount(INDEX_STATS_CUTOFFS, 1);
+					so->cutoff = true;
+				}
+
 				if (pairingheap_is_empty(so->discarded))
 					break;
 
+				/* Remaining candidates are outside the radius */
+				if (HnswGetSearchCandidate(w_node, pairingheap_first(so->discarded))->distance > so->q.maxDistance)
+					break;
+
 				/* Return remaining tuples */
-				so->w = lappend(so->w, HnswGetSearchCandidate(w_node, pairingheap_remove_first(so->discarded)));
+				sc = HnswGetSearchCandidate(w_node, pairingheap_remove_first(so->discarded));
+
+				/* Ensure the element is not deleted (and replaced) while loading */
+				LockPage(scan->indexRelation, HNSW_SCAN_LOCK, ShareLock);
+				loaded = LoadCandidate(scan, sc);
+				UnlockPage(scan->indexRelation, HNSW_SCAN_LOCK, ShareLock);
+
+				if (!loaded)
+				{
+					pfree(sc);
+					continue;
+				}
+
+				so->w = SetLowerBounds(so, lappend(so->w, sc));
 			}
 			else
 			{
@@ -303,15 +692,30 @@ hnswgettuple(IndexScanDesc scan, ScanDirection dir)
 			so->previousDistance = sc->distance;
 		}
 
+		/* Heap TID was removed by vacuum after the element was read */
+		if (scan->xs_want_itup && !FetchReturnTuple(scan, element, heaptid))
+			continue;
+
 		MemoryContextSwitchTo(oldCtx);
 
 		scan->xs_heaptid = *heaptid;
 		scan->xs_recheck = false;
-		scan->xs_recheckorderby = false;
+		scan->xs_recheckorderby = so->sq8;
+
+		/* Let the executor reorder rows by their exact distances */
+		if (so->sq8)
+		{
+			scan->xs_orderbyvals[0] = Float8GetDatum(HnswGetOrderByDistance(so->distanceType, sc->distance));
+			scan->xs_orderbynulls[0] = DatumGetPointer(so->q.value) == NULL;
+		}
+
+		IndexStatsEnd(prevCounts);
 		return true;
 	}
 
 	MemoryContextSwitchTo(oldCtx);
+
+	IndexStatsEnd(prevCounts);
 	return false;
 }
 
@@ -323,8 +727,765 @@ hnswendscan(IndexScanDesc scan)
 {
 	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
 
+	IndexStatsFlush(scan->indexRelation, &so->counts);
+
 	MemoryContextDelete(so->tmpCtx);
+	MemoryContextDelete(so->tupleCtx);
 
 	pfree(so);
 	scan->opaque = NULL;
 }
+
+/*
+ * Check if the index can return a column for index-only scans
+ */
+bool
+hnswcanreturn(Relation index, int attno)
+{
+	/* Value is not stored as-is when quantized or normalized */
+	if (attno == 1)
+		return !HnswUseSq8(index) && !OidIsValid(index_getprocid(index, 1, HNSW_NORM_PROC));
+
+	return true;
+}
+
+/*
+ * Get the value of a constant or external parameter of a LIMIT
+ */
+static bool
+GetLimitValue(Node *expr, ParamListInfo params, int64 *value)
+{
+	if (expr == NULL)
+	{
+		*value = 0;
+		return true;
+	}
+
+	if (IsA(expr, Const))
+	{
+		Const	   *c = (Const *) expr;
+
+		if (c->constisnull || c->consttype != INT8OID)
+			return false;
+
+		*value = DatumGetInt64(c->constvalue);
+		return true;
+	}
+
+	/* Generic plans of prepared statements */
+	if (IsA(expr, Param) && ((Param *) expr)->paramkind == PARAM_EXTERN && params != NULL)
+	{
+		int			paramid = ((Param *) expr)->paramid;
+		ParamExternData *prm;
+		ParamExternData prmdata;
+
+		if (paramid <= 0 || paramid > params->numParams)
+			return false;
+
+		if (params->paramFetch != NULL)
+			prm = params->paramFetch(params, paramid, false, &prmdata);
+		else
+			prm = &params->params[paramid - 1];
+
+		if (prm->isnull || prm->ptype != INT8OID)
+			return false;
+
+		*value = DatumGetInt64(prm->value);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Remove the bounds of an executor state when its memory is freed
+ */
+static void
+RemoveScanBounds(void *arg)
+{
+	HnswScanBounds **prev = &scanBounds;
+
+	while (*prev != NULL)
+	{
+		if ((*prev)->estate == (EState *) arg)
+			*prev = (*prev)->next;
+		else
+			prev = &(*prev)->next;
+	}
+}
+
+/*
+ * Get the bounds of a scan, adding them if needed
+ */
+static HnswScanBounds *
+GetScanBounds(EState *estate, ScanKey orderbys)
+{
+	MemoryContext oldCtx;
+	HnswScanBounds *sb;
+	bool		registered = false;
+
+	for (HnswScanBounds * other = scanBounds; other != NULL; other = other->next)
+	{
+		if (other->estate == estate)
+		{
+			if (other->orderbys == orderbys)
+				return other;
+
+			registered = true;
+		}
+	}
+
+	oldCtx = MemoryContextSwitchTo(estate->es_query_cxt);
+
+	if (!registered)
+	{
+		MemoryContextCallback *cb = palloc(sizeof(MemoryContextCallback));
+
+		cb->func = RemoveScanBounds;
+		cb->arg = estate;
+		MemoryContextRegisterResetCallback(estate->es_query_cxt, cb);
+	}
+
+	sb = palloc(sizeof(HnswScanBounds));
+	sb->orderbys = orderbys;
+	sb->limit = 0;
+	sb->estate = estate;
+	sb->next = scanBounds;
+	scanBounds = sb;
+
+	MemoryContextSwitchTo(oldCtx);
+
+	return sb;
+}
+
+/*
+ * Get the index and ORDER BY keys of an hnsw scan
+ */
+static bool
+GetHnswScan(PlanState *planstate, ScanKey *orderbys)
+{
+	Relation	index = NULL;
+
+	if (IsA(planstate, IndexScanState))
+	{
+		index = ((IndexScanState *) planstate)->iss_RelationDesc;
+		*orderbys = ((IndexScanState *) planstate)->iss_OrderByKeys;
+	}
+	else if (IsA(planstate, IndexOnlyScanState))
+	{
+		index = ((IndexOnlyScanState *) planstate)->ioss_RelationDesc;
+		*orderbys = ((IndexOnlyScanState *) planstate)->ioss_OrderByKeys;
+	}
+
+	return index != NULL && *orderbys != NULL && index->rd_indam->amgettuple == hnswgettuple;
+}
+
+/*
+ * Find hnsw scans directly below a LIMIT
+ */
+static bool
+FindScanBounds(PlanState *planstate, void *context)
+{
+	EState	   *estate = (EState *) context;
+	ScanKey		orderbys;
+
+	if (planstate == NULL)
+		return false;
+
+	if (hnsw_ef_search_factor > 0 && IsA(planstate, LimitState) &&
+		outerPlanState(planstate) != NULL &&
+		GetHnswScan(outerPlanState(planstate), &orderbys))
+	{
+		Limit	   *plan = (Limit *) planstate->plan;
+		int64		count;
+		int64		offset;
+
+		if (plan->limitCount != NULL &&
+			GetLimitValue(plan->limitCount, estate->es_param_list_info, &count) &&
+			GetLimitValue(plan->limitOffset, estate->es_param_list_info, &offset) &&
+			count > 0 && offset >= 0)
+			GetScanBounds(estate, orderbys)->limit = count > PG_INT64_MAX - offset ? PG_INT64_MAX : count + offset;
+	}
+
+	return planstate_tree_walker(planstate, FindScanBounds, context);
+}
+
+/*
+ * Pass the LIMIT of queries to hnsw scans
+ */
+static void
+HnswExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		FindScanBounds(queryDesc->planstate, queryDesc->estate);
+}
+
+/*
+ * Install executor hook
+ */
+void
+HnswInitExecutorHook(void)
+{
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = HnswExecutorStart;
+}
+
+/*
+ * Get the bound of a qual like distance < r on the ORDER BY expression
+ */
+static Expr *
+GetRangeBound(Expr *clause, Expr *orderby)
+{
+	OpExpr	   *op = (OpExpr *) clause;
+	Oid			opfunc;
+	Expr	   *distance;
+	Expr	   *bound;
+
+	if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+		return NULL;
+
+	opfunc = get_opcode(op->opno);
+	if (opfunc == F_FLOAT8LT || opfunc == F_FLOAT8LE)
+	{
+		distance = linitial(op->args);
+		bound = lsecond(op->args);
+	}
+	else if (opfunc == F_FLOAT8GT || opfunc == F_FLOAT8GE)
+	{
+		distance = lsecond(op->args);
+		bound = linitial(op->args);
+	}
+	else
+		return NULL;
+
+	/* Bound is evaluated once per scan */
+	if (!equal(distance, orderby) || contain_var_clause((Node *) bound) ||
+		contain_volatile_functions((Node *) bound) || contain_subplans((Node *) bound))
+		return NULL;
+
+	return bound;
+}
+
+/*
+ * Add range conditions to an hnsw index path for quals on its ORDER BY
+ * expression. Conditions are lossy, so the quals still filter rows.
+ */
+static void
+AddRangeIndexClauses(PlannerInfo *root, RelOptInfo *rel, IndexPath *path, Oid amoid)
+{
+	IndexOptInfo *indexinfo = path->indexinfo;
+	OpExpr	   *orderby;
+	Oid			rangeop;
+	List	   *iclauses = NIL;
+	ListCell   *lc;
+
+	if (indexinfo->relam != amoid || list_length(path->indexorderbys) != 1)
+		return;
+
+	orderby = (OpExpr *) linitial(path->indexorderbys);
+	if (!IsA(orderby, OpExpr) || list_length(orderby->args) != 2)
+		return;
+
+	/* Opclasses from before 0.8.1 have no range operator */
+	rangeop = get_opfamily_member(indexinfo->opfamily[0], indexinfo->opcintype[0], RECORDOID, HNSW_RANGE_STRATEGY);
+	if (!OidIsValid(rangeop))
+		return;
+
+	foreach(lc, rel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Expr	   *bound = GetRangeBound(rinfo->clause, (Expr *) orderby);
+		RowExpr    *range;
+		OpExpr	   *qual;
+		IndexClause *iclause;
+
+		if (bound == NULL)
+			continue;
+
+		range = makeNode(RowExpr);
+		range->args = list_make3(copyObject(lsecond(orderby->args)), copyObject(bound),
+								 makeConst(REGOPERATOROID, -1, InvalidOid, sizeof(Oid), ObjectIdGetDatum(orderby->opno), false, true));
+		range->row_typeid = RECORDOID;
+		range->row_format = COERCE_IMPLICIT_CAST;
+		range->colnames = list_make3(makeString(pstrdup("query")), makeString(pstrdup("radius")), makeString(pstrdup("operator")));
+		range->location = -1;
+
+		qual = (OpExpr *) make_opclause(rangeop, BOOLOID, false, copyObject(linitial(orderby->args)), (Expr *) range, InvalidOid, orderby->inputcollid);
+		set_opfuncid(qual);
+
+		iclause = makeNode(IndexClause);
+		iclause->rinfo = rinfo;
+#if PG_VERSION_NUM >= 160000
+		iclause->indexquals = list_make1(make_simple_restrictinfo(root, (Expr *) qual));
+#else
+		iclause->indexquals = list_make1(make_simple_restrictinfo((Expr *) qual));
+#endif
+		iclause->lossy = true;
+		iclause->indexcol = 0;
+		iclause->indexcols = NIL;
+		iclauses = lappend(iclauses, iclause);
+	}
+
+	/* Clauses are in column order, and the list can be shared with other paths */
+	if (iclauses != NIL)
+		path->indexclauses = list_concat(iclauses, path->indexclauses);
+}
+
+/*
+ * Use quals on the distance from the ORDER BY expression as index conditions
+ */
+static void
+HnswSetRelPathlist(PlannerInfo *root, RelOptInfo *rel, Index rti, RangeTblEntry *rte)
+{
+	Oid			amoid = InvalidOid;
+	ListCell   *lc;
+
+	if (prev_set_rel_pathlist)
+		prev_set_rel_pathlist(root, rel, rti, rte);
+
+	if (rel->baserestrictinfo == NIL)
+		return;
+
+	foreach(lc, rel->pathlist)
+	{
+		IndexPath  *path = (IndexPath *) lfirst(lc);
+
+		if (!IsA(path, IndexPath) || path->indexorderbys == NIL)
+			continue;
+
+		/* Extension may not be created in the database */
+		if (!OidIsValid(amoid))
+		{
+			amoid = get_am_oid("hnsw", true);
+			if (!OidIsValid(amoid))
+				return;
+		}
+
+		AddRangeIndexClauses(root, rel, path, amoid);
+	}
+}
+
+/*
+ * Install planner hook
+ */
+void
+HnswInitPlannerHook(void)
+{
+	prev_set_rel_pathlist = set_rel_pathlist_hook;
+	set_rel_pathlist_hook = HnswSetRelPathlist;
+}
+
+/*
+ * Check if a value is within a range of a distance operator
+ */
+FUNCTION_PREFIX PG_FUNCTION_INFO_V1(hnsw_within);
+Datum
+hnsw_within(PG_FUNCTION_ARGS)
+{
+	Datum		value = PG_GETARG_DATUM(0);
+	Oid			type = get_fn_expr_argtype(fcinfo->flinfo, 0);
+	Datum		query;
+	double		radius;
+	Oid			operator;
+	double		distance;
+
+	if (!GetRange(PG_GETARG_DATUM(1), type, &query, &radius, &operator))
+		PG_RETURN_NULL();
+
+	distance = DatumGetFloat8(OidFunctionCall2Coll(get_opcode(operator), PG_GET_COLLATION(), value, query));
+
+	PG_RETURN_BOOL(float8_le(distance, radius));
+}
+
+/*
+ * Open an hnsw index and its table for a search function
+ */
+static Relation
+OpenSearchIndex(Oid indexOid, Relation *heap)
+{
+	Oid			heapOid;
+	Relation	index;
+	AclResult	aclresult;
+
+	/* Lock the table before the index */
+	heapOid = IndexGetRelation(indexOid, true);
+	if (!OidIsValid(heapOid))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an index", get_rel_name(indexOid))));
+
+	*heap = table_open(heapOid, AccessShareLock);
+	index = index_open(indexOid, AccessShareLock);
+
+	/* Returns rows, so requires the same privilege as scanning the table */
+	aclresult = pg_class_aclcheck(heapOid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, get_relkind_objtype((*heap)->rd_rel->relkind), RelationGetRelationName(*heap));
+
+	if (index->rd_rel->relam != get_index_am_oid("hnsw", false))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not an hnsw index", RelationGetRelationName(index))));
+
+	/* Index may still be building or be left over from a failed build */
+	if (!index->rd_index->indisvalid || !index->rd_index->indisready)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot search invalid index \"%s\"", RelationGetRelationName(index))));
+
+	return index;
+}
+
+/*
+ * Search the index for each query in an array
+ */
+FUNCTION_PREFIX PG_FUNCTION_INFO_V1(hnsw_search_batch);
+Datum
+hnsw_search_batch(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			indexOid;
+	ArrayType  *queries;
+	int			k;
+	int			ef = hnsw_ef_search;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldCtx;
+	MemoryContext tmpCtx;
+	Relation	heap;
+	Relation	index;
+	const		HnswTypeInfo *typeInfo;
+	HnswSupport support;
+	FmgrInfo	distanceinfo;
+	Oid			distanceop;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	Datum	   *elems;
+	bool	   *nulls;
+	int			nelems;
+	int			m;
+	HnswElement entryPoint;
+	HnswQuery	q;
+	Snapshot	snapshot;
+	IndexFetchTableData *fetch;
+	TupleTableSlot *slot;
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) || !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldCtx = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldCtx);
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1) || PG_ARGISNULL(2))
+		return (Datum) 0;
+
+	indexOid = PG_GETARG_OID(0);
+	queries = PG_GETARG_ARRAYTYPE_P(1);
+	k = PG_GETARG_INT32(2);
+
+	if (!PG_ARGISNULL(3))
+		ef = PG_GETARG_INT32(3);
+
+	/* Results come from the candidate list, so k is bounded like ef */
+	if (k < 1 || k > HNSW_MAX_EF_SEARCH)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k must be between 1 and %d", HNSW_MAX_EF_SEARCH)));
+
+	if (ef < HNSW_MIN_EF_SEARCH || ef > HNSW_MAX_EF_SEARCH)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("ef must be between %d and %d", HNSW_MIN_EF_SEARCH, HNSW_MAX_EF_SEARCH)));
+
+	/* Keep at least k candidates, like scans with a LIMIT */
+	ef = Max(ef, k);
+
+	index = OpenSearchIndex(indexOid, &heap);
+	prevCounts = IndexStatsBegin(&counts);
+
+	if (ARR_NDIM(queries) > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+				 errmsg("queries must be a one-dimensional array")));
+
+	if (ARR_ELEMTYPE(queries) != index->rd_opcintype[0])
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("queries must be an array of %s", format_type_be(index->rd_opcintype[0]))));
+
+	typeInfo = HnswGetTypeInfo(index);
+	HnswInitSupport(&support, index);
+
+	/* Report the distance of the operator used in ORDER BY */
+	distanceop = get_opfamily_member(index->rd_opfamily[0], index->rd_opcintype[0], index->rd_opcintype[0], 1);
+	if (!OidIsValid(distanceop))
+		elog(ERROR, "missing distance operator for hnsw index");
+	fmgr_info(get_opcode(distanceop), &distanceinfo);
+
+	get_typlenbyvalalign(ARR_ELEMTYPE(queries), &typlen, &typbyval, &typalign);
+	deconstruct_array(queries, ARR_ELEMTYPE(queries), typlen, typbyval, typalign, &elems, &nulls, &nelems);
+
+	tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+								   "Hnsw batch temporary context",
+								   ALLOCSET_DEFAULT_SIZES);
+
+	q.tupdesc = RelationGetDescr(index);
+	q.keys = NULL;
+	q.nkeys = 0;
+	q.maxDistance = get_float8_infinity();
+	q.limit = 0;
+	q.trace = NULL;
+
+	snapshot = GetActiveSnapshot();
+	fetch = table_index_fetch_begin(heap);
+	slot = table_slot_create(heap, NULL);
+
+	for (int i = 0; i < nelems; i++)
+	{
+		char	   *base = NULL;
+		HnswElement ep;
+		List	   *w;
+		int			count = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (nulls[i])
+			continue;
+
+		oldCtx = MemoryContextSwitchTo(tmpCtx);
+
+		/* Value should not be short or compressed */
+		q.value = PointerGetDatum(PG_DETOAST_DATUM(elems[i]));
+
+		/* Normalize if needed */
+		if (support.normprocinfo != NULL)
+			q.value = HnswNormValue(typeInfo, support.collation, q.value);
+
+		/* Lock per query so vacuum is not blocked for the whole batch */
+		LockPage(index, HNSW_SCAN_LOCK, ShareLock);
+
+		/* Get m and entry point */
+		q.sharedCache = HnswGetMetaPageInfo(index, &m, &entryPoint, &q.cacheVersion, &q.upperVersion);
+
+		if (entryPoint == NULL)
+		{
+			UnlockPage(index, HNSW_SCAN_LOCK, ShareLock);
+			MemoryContextSwitchTo(oldCtx);
+			MemoryContextReset(tmpCtx);
+			break;
+		}
+
+		ep = HnswInitElementFromBlock(entryPoint->blkno, entryPoint->offno);
+		ep->level = entryPoint->level;
+
+		w = SearchGraph(index, &q, &support, m, ep, ef, NULL, NULL, NULL);
+
+		/* Nearest element is last */
+		for (int j = list_length(w) - 1; j >= 0 && count < k; j--)
+		{
+			HnswSearchCandidate *sc = list_nth(w, j);
+			HnswElement element = HnswPtrAccess(base, sc->element);
+			bool		loaded = false;
+			double		distance = 0;
+
+			for (int h = 0; h < element->heaptidsLength && count < k; h++)
+			{
+				ItemPointerData tid = element->heaptids[h];
+				bool		call_again = false;
+				bool		all_dead = false;
+				Datum		values[3];
+				bool		isnull[3] = {false, false, false};
+
+				/* Skip rows that are not visible */
+				if (!table_index_fetch_tuple(fetch, &tid, snapshot, slot, &call_again, &all_dead))
+					continue;
+
+				/* Calculate from the vector stored in the index */
+				if (!loaded)
+				{
+					HnswElement e = HnswInitElementFromBlock(element->blkno, element->offno);
+					double		indexDistance;
+
+					HnswLoadElement(e, &indexDistance, &q, index, &support, true, NULL);
+					distance = DatumGetFloat8(FunctionCall2Coll(&distanceinfo, support.collation, HnswGetValue(base, e), q.value));
+					loaded = true;
+				}
+
+				values[0] = Int32GetDatum(ARR_LBOUND(queries)[0] + i);
+				values[1] = PointerGetDatum(&slot->tts_tid);
+				values[2] = Float8GetDatum(distance);
+				tuplestore_putvalues(tupstore, tupdesc, values, isnull);
+				count++;
+			}
+		}
+
+		UnlockPage(index, HNSW_SCAN_LOCK, ShareLock);
+
+		MemoryContextSwitchTo(oldCtx);
+		MemoryContextReset(tmpCtx);
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+	table_index_fetch_end(fetch);
+
+	MemoryContextDelete(tmpCtx);
+	IndexStatsEnd(prevCounts);
+	IndexStatsFlush(index, &counts);
+	index_close(index, AccessShareLock);
+	table_close(heap, AccessShareLock);
+
+	return (Datum) 0;
+}
+
+typedef struct HnswTraceState
+{
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	HnswDistanceType distanceType;
+	int			step;
+}			HnswTraceState;
+
+/*
+ * Add a row for an expansion
+ */
+static void
+AddTraceStep(HnswSearchStep * step, void *arg)
+{
+	HnswTraceState *state = (HnswTraceState *) arg;
+	ItemPointerData indextid;
+	Datum		values[7];
+	bool		isnull[7] = {false, false, false, false, false, false, false};
+
+	ItemPointerSet(&indextid, step->blkno, step->offno);
+
+	values[0] = Int32GetDatum(++state->step);
+	values[1] = Int32GetDatum(step->layer);
+	values[2] = PointerGetDatum(&indextid);
+	values[3] = Float8GetDatum(HnswGetOrderByDistance(state->distanceType, step->distance));
+	values[4] = Int32GetDatum(step->scored);
+	values[5] = Int32GetDatum(step->skipped);
+	values[6] = Float8GetDatum(HnswGetOrderByDistance(state->distanceType, step->boundary));
+	tuplestore_putvalues(state->tupstore, state->tupdesc, values, isnull);
+}
+
+/*
+ * Return each expansion of the search for a query
+ */
+FUNCTION_PREFIX PG_FUNCTION_INFO_V1(hnsw_search_trace);
+Datum
+hnsw_search_trace(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			indexOid;
+	Oid			queryType;
+	int			ef = hnsw_ef_search;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldCtx;
+	Relation	heap;
+	Relation	index;
+	const		HnswTypeInfo *typeInfo;
+	HnswSupport support;
+	HnswTraceState state;
+	int			m;
+	HnswElement entryPoint;
+	HnswQuery	q;
+	int64		tuples = 0;
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) || !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldCtx = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldCtx);
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1))
+		return (Datum) 0;
+
+	indexOid = PG_GETARG_OID(0);
+	queryType = get_fn_expr_argtype(fcinfo->flinfo, 1);
+
+	if (!PG_ARGISNULL(2))
+		ef = PG_GETARG_INT32(2);
+
+	if (ef < HNSW_MIN_EF_SEARCH || ef > HNSW_MAX_EF_SEARCH)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("ef must be between %d and %d", HNSW_MIN_EF_SEARCH, HNSW_MAX_EF_SEARCH)));
+
+	index = OpenSearchIndex(indexOid, &heap);
+	prevCounts = IndexStatsBegin(&counts);
+
+	if (queryType != index->rd_opcintype[0])
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("query must be of type %s", format_type_be(index->rd_opcintype[0]))));
+
+	typeInfo = HnswGetTypeInfo(index);
+	HnswInitSupport(&support, index);
+
+	state.tupstore = tupstore;
+	state.tupdesc = tupdesc;
+	state.distanceType = HnswGetDistanceType(&support);
+	state.step = 0;
+
+	/* Value should not be short or compressed */
+	q.value = PointerGetDatum(PG_DETOAST_DATUM(PG_GETARG_DATUM(1)));
+
+	/* Normalize if needed */
+	if (support.normprocinfo != NULL)
+		q.value = HnswNormValue(typeInfo, support.collation, q.value);
+
+	/* Same as the first iteration of a scan */
+	LockPage(index, HNSW_SCAN_LOCK, ShareLock);
+	q.sharedCache = HnswGetMetaPageInfo(index, &m, &entryPoint, &q.cacheVersion, &q.upperVersion);
+	q.tupdesc = RelationGetDescr(index);
+	q.keys = NULL;
+	q.nkeys = 0;
+	q.maxDistance = get_float8_infinity();
+	q.limit = 0;
+	q.trace = AddTraceStep;
+	q.traceArg = &state;
+
+	if (entryPoint != NULL)
+		SearchGraph(index, &q, &support, m, entryPoint, ef, NULL, NULL, &tuples);
+
+	UnlockPage(index, HNSW_SCAN_LOCK, ShareLock);
+
+	IndexStatsEnd(prevCounts);
+	IndexStatsFlush(index, &counts);
+
+	index_close(index, AccessShareLock);
+	table_close(heap, AccessShareLock);
+
+	return (Datum) 0;
+}
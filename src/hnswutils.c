@@ -1,5 +1,6 @@
 #include "postgres.h"
 
+#include <float.h>
 #include <math.h>
 
 #include "access/generic_xlog.h"
@@ -12,6 +13,7 @@
 #include "sparsevec.h"
 #include "storage/bufmgr.h"
 #include "utils/datum.h"
+#include "utils/float.h"
 #include "utils/memdebug.h"
 #include "utils/rel.h"
 
@@ -58,48 +60,6 @@ hash_tid(ItemPointerData tid)
 #define SH_DEFINE
 #include "lib/simplehash.h"
 
-/* Pointer hash table */
-static uint32
-hash_pointer(uintptr_t ptr)
-{
-#if SIZEOF_VOID_P == 8
-	return murmurhash64((uint64) ptr);
-#else
-	return murmurhash32((uint32) ptr);
-#endif
-}
-
-#define SH_PREFIX		pointerhash
-#define SH_ELEMENT_TYPE	PointerHashEntry
-#define SH_KEY_TYPE		uintptr_t
-#define	SH_KEY			ptr
-#define SH_HASH_KEY(tb, key)	hash_pointer(key)
-#define SH_EQUAL(tb, a, b)		(a == b)
-#define	SH_SCOPE		extern
-#define SH_DEFINE
-#include "lib/simplehash.h"
-
-/* Offset hash table */
-static uint32
-hash_offset(Size offset)
-{
-#if SIZEOF_SIZE_T == 8
-	return murmurhash64((uint64) offset);
-#else
-	return murmurhash32((uint32) offset);
-#endif
-}
-
-#define SH_PREFIX		offsethash
-#define SH_ELEMENT_TYPE	OffsetHashEntry
-#define SH_KEY_TYPE		Size
-#define	SH_KEY			offset
-#define SH_HASH_KEY(tb, key)	hash_offset(key)
-#define SH_EQUAL(tb, a, b)		(a == b)
-#define	SH_SCOPE		extern
-#define SH_DEFINE
-#include "lib/simplehash.h"
-
 /*
  * Get the max number of connections in an upper layer for each element in the index
  */
@@ -128,6 +88,256 @@ HnswGetEfConstruction(Relation index)
 	return HNSW_DEFAULT_EF_CONSTRUCTION;
 }
 
+PGDLLEXPORT Datum vector_l2_squared_distance(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum vector_negative_inner_product(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum l1_distance(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum halfvec_l2_squared_distance(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum halfvec_negative_inner_product(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum sparsevec_l2_squared_distance(PG_FUNCTION_ARGS);
+PGDLLEXPORT Datum sparsevec_negative_inner_product(PG_FUNCTION_ARGS);
+
+/*
+ * Quantize a vector to 8-bit codes using its own range
+ */
+static void
+HnswQuantizeSq8(Vector * vec, HnswSq8Vector * result)
+{
+	float		min = vec->x[0];
+	float		max = vec->x[0];
+	double		scale;
+
+	for (int i = 1; i < vec->dim; i++)
+	{
+		if (vec->x[i] < min)
+			min = vec->x[i];
+
+		if (vec->x[i] > max)
+			max = vec->x[i];
+	}
+
+	/* Use double to prevent overflow */
+	scale = ((double) max - (double) min) / 255;
+
+	SET_VARSIZE(result, HNSW_SQ8_SIZE(vec->dim));
+	result->dim = vec->dim;
+	result->unused = 0;
+	result->min = min;
+	result->scale = scale;
+
+	for (int i = 0; i < vec->dim; i++)
+	{
+		double		code = scale > 0 ? rint(((double) vec->x[i] - min) / scale) : 0;
+
+		result->x[i] = (uint8) Min(Max(code, 0), 255);
+	}
+}
+
+/*
+ * Convert 8-bit codes back to a vector
+ */
+static Vector *
+HnswDequantizeSq8(HnswSq8Vector * vec)
+{
+	Vector	   *result = InitVector(vec->dim);
+
+	for (int i = 0; i < vec->dim; i++)
+		result->x[i] = vec->min + vec->scale * vec->x[i];
+
+	return result;
+}
+
+/*
+ * Ensure same dimensions
+ */
+static inline void
+HnswCheckSq8Dims(Vector * a, HnswSq8Vector * b)
+{
+	if (a->dim != b->dim)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("different vector dimensions %d and %d", a->dim, b->dim)));
+}
+
+/*
+ * Get the L2 squared distance between a vector and 8-bit codes
+ */
+static double
+HnswSq8L2SquaredDistance(Datum a, Datum b)
+{
+	Vector	   *q = DatumGetVector(a);
+	HnswSq8Vector *v = (HnswSq8Vector *) DatumGetPointer(b);
+	float		min = v->min;
+	float		scale = v->scale;
+	float		distance = 0.0;
+
+	HnswCheckSq8Dims(q, v);
+
+	/* Auto-vectorized */
+	for (int i = 0; i < v->dim; i++)
+	{
+		float		diff = q->x[i] - (min + scale * v->x[i]);
+
+		distance += diff * diff;
+	}
+
+	return (double) distance;
+}
+
+/*
+ * Get the negative inner product of a vector and 8-bit codes
+ */
+static double
+HnswSq8NegativeInnerProduct(Datum a, Datum b)
+{
+	Vector	   *q = DatumGetVector(a);
+	HnswSq8Vector *v = (HnswSq8Vector *) DatumGetPointer(b);
+	float		sum = 0.0;
+	float		dot = 0.0;
+
+	HnswCheckSq8Dims(q, v);
+
+	/* Auto-vectorized */
+	for (int i = 0; i < v->dim; i++)
+	{
+		sum += q->x[i];
+		dot += q->x[i] * v->x[i];
+	}
+
+	return -((double) v->min * sum + (double) v->scale * dot);
+}
+
+/*
+ * Get the L1 distance between a vector and 8-bit codes
+ */
+static double
+HnswSq8L1Distance(Datum a, Datum b)
+{
+	Vector	   *q = DatumGetVector(a);
+	HnswSq8Vector *v = (HnswSq8Vector *) DatumGetPointer(b);
+	float		min = v->min;
+	float		scale = v->scale;
+	float		distance = 0.0;
+
+	HnswCheckSq8Dims(q, v);
+
+	/* Auto-vectorized */
+	for (int i = 0; i < v->dim; i++)
+		distance += fabsf(q->x[i] - (min + scale * v->x[i]));
+
+	return (double) distance;
+}
+
+/*
+ * Get the kernel that works on 8-bit codes directly, or NULL if none
+ */
+static VectorDistanceKernel
+HnswGetSq8Kernel(PGFunction fn)
+{
+	if (fn == vector_l2_squared_distance)
+		return HnswSq8L2SquaredDistance;
+
+	if (fn == vector_negative_inner_product)
+		return HnswSq8NegativeInnerProduct;
+
+	if (fn == l1_distance)
+		return HnswSq8L1Distance;
+
+	return NULL;
+}
+
+/*
+ * Get the per-dimension error of 8-bit codes. Codes are rounded to the
+ * nearest step, and the rest covers rounding when decoding and when summing
+ * distances in float, which is at most dim * FLT_EPSILON of the magnitude.
+ */
+static float
+HnswGetSq8Error(HnswSq8Vector * vec)
+{
+	double		magnitude = fabs((double) vec->min) + 255 * (double) vec->scale;
+
+	return (float) ((double) vec->scale / 2 + (vec->dim + 2) * FLT_EPSILON * magnitude);
+}
+
+/*
+ * Get how much the distance to 8-bit codes can differ from the distance to
+ * the original vector per unit of error of the codes
+ */
+double
+HnswGetSq8ErrorFactor(HnswSupport * support, Datum q)
+{
+	Vector	   *v;
+	double		norm = 0;
+
+	if (DatumGetPointer(q) == NULL)
+		return 0;
+
+	v = DatumGetVector(q);
+
+	if (support->sq8Kernel == HnswSq8L2SquaredDistance)
+		return sqrt(v->dim);
+
+	if (support->sq8Kernel == HnswSq8L1Distance)
+		return v->dim;
+
+	/* L1 norm of the query for inner product */
+	for (int i = 0; i < v->dim; i++)
+		norm += fabs(v->x[i]);
+
+	return norm;
+}
+
+/*
+ * Get a lower bound of the distance to the original vector from the distance
+ * to 8-bit codes, in index distances. The bound also allows for rounding of
+ * both distances, so the distance the executor calculates is never below it.
+ */
+double
+HnswGetSq8LowerBound(HnswSupport * support, Datum q, double factor, double distance, float error)
+{
+	double		relative;
+	double		bound;
+
+	if (DatumGetPointer(q) == NULL)
+		return distance;
+
+	relative = 1 - DatumGetVector(q)->dim * FLT_EPSILON;
+
+	if (support->sq8Kernel == HnswSq8L2SquaredDistance)
+	{
+		/* Triangle inequality, before squaring */
+		bound = Max((sqrt(distance) * relative - factor * error) * relative, 0);
+		return bound * bound;
+	}
+
+	if (support->sq8Kernel == HnswSq8L1Distance)
+		return Max((distance * relative - factor * error) * relative, 0);
+
+	/* Also allow for the offset of cosine distance */
+	if (support->sq8Kernel == HnswSq8NegativeInnerProduct)
+		return distance - factor * error - (1 - relative) * (fabs(distance) + 1);
+
+	return -get_float8_infinity();
+}
+
+/*
+ * Check if element tuples should store sq8 codes
+ */
+bool
+HnswUseSq8(Relation index)
+{
+	HnswOptions *opts = (HnswOptions *) index->rd_options;
+
+	if (!opts || opts->quantization != HNSW_QUANTIZATION_SQ8)
+		return false;
+
+	if (!HnswGetTypeInfo(index)->supportsSq8)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("sq8 quantization is only supported for vector type")));
+
+	return true;
+}
+
 /*
  * Get proc
  */
@@ -146,9 +356,27 @@ HnswOptionalProcInfo(Relation index, uint16 procnum)
 void
 HnswInitSupport(HnswSupport * support, Relation index)
 {
+	const		HnswTypeInfo *typeInfo = HnswGetTypeInfo(index);
+
 	support->procinfo = index_getprocinfo(index, 1, HNSW_DISTANCE_PROC);
 	support->collation = index->rd_indcollation[0];
 	support->normprocinfo = HnswOptionalProcInfo(index, HNSW_NORM_PROC);
+
+	/* Skip fmgr for built-in distance functions */
+	if (typeInfo->getDistanceKernel != NULL)
+		support->kernel = typeInfo->getDistanceKernel(support->procinfo->fn_addr);
+	else
+		support->kernel = NULL;
+
+	if (typeInfo->getDistanceBatchKernel != NULL)
+		support->batchKernel = typeInfo->getDistanceBatchKernel(support->procinfo->fn_addr);
+	else
+		support->batchKernel = NULL;
+
+	if (typeInfo->supportsSq8)
+		support->sq8Kernel = HnswGetSq8Kernel(support->procinfo->fn_addr);
+	else
+		support->sq8Kernel = NULL;
 }
 
 /*
@@ -160,6 +388,93 @@ HnswNormValue(const HnswTypeInfo * typeInfo, Oid collation, Datum value)
 	return DirectFunctionCall1Coll(typeInfo->normalize, collation, value);
 }
 
+/*
+ * Get how index distances relate to distances of the ORDER BY operator
+ */
+HnswDistanceType
+HnswGetDistanceType(HnswSupport * support)
+{
+	PGFunction	fn = support->procinfo->fn_addr;
+
+	/* Index uses squared distance for L2 */
+	if (fn == vector_l2_squared_distance || fn == halfvec_l2_squared_distance || fn == sparsevec_l2_squared_distance)
+		return HNSW_DISTANCE_SQUARED;
+
+	/* Index uses negative inner product of normalized vectors for cosine */
+	if ((fn == vector_negative_inner_product || fn == halfvec_negative_inner_product || fn == sparsevec_negative_inner_product) && support->normprocinfo != NULL)
+		return HNSW_DISTANCE_COSINE;
+
+	return HNSW_DISTANCE_SAME;
+}
+
+/*
+ * Convert a distance from the ORDER BY operator to the distance used by the index
+ */
+double
+HnswGetIndexDistance(HnswDistanceType type, double distance)
+{
+	if (isinf(distance))
+		return distance;
+
+	switch (type)
+	{
+		case HNSW_DISTANCE_SQUARED:
+			return distance >= 0 ? distance * distance : -1;
+		case HNSW_DISTANCE_COSINE:
+			return distance - 1;
+		default:
+			return distance;
+	}
+}
+
+/*
+ * Convert a distance used by the index to the distance from the ORDER BY operator
+ */
+double
+HnswGetOrderByDistance(HnswDistanceType type, double distance)
+{
+	switch (type)
+	{
+		case HNSW_DISTANCE_SQUARED:
+			return sqrt(distance);
+		case HNSW_DISTANCE_COSINE:
+			return distance + 1;
+		default:
+			return distance;
+	}
+}
+
+/*
+ * Get how far index distances can be below the ORDER BY operator from
+ * rounding, in index distances
+ */
+double
+HnswGetDistanceEpsilon(HnswSupport * support, HnswDistanceType type, int dimensions, double distance)
+{
+	switch (type)
+	{
+		case HNSW_DISTANCE_SQUARED:
+			/* Both use the same sum, so only squaring the radius rounds */
+			return DBL_EPSILON * fabs(distance);
+		case HNSW_DISTANCE_COSINE:
+			{
+				/*
+				 * Normalized elements are rounded to their type, which changes
+				 * the inner product of unit vectors by up to the epsilon of
+				 * the type. Sums in single precision on each side add up to
+				 * the epsilon times the number of terms.
+				 */
+				PGFunction	fn = support->procinfo->fn_addr;
+				double		elementEpsilon = fn == halfvec_negative_inner_product ? 1.0 / 1024 : FLT_EPSILON;
+
+				return elementEpsilon + 2 * (Max(dimensions, 0) + 1) * FLT_EPSILON;
+			}
+		default:
+			/* Same function */
+			return 0;
+	}
+}
+
 /*
  * Check if non-zero norm
  */
@@ -251,6 +566,7 @@ HnswInitElement(char *base, ItemPointer heaptid, int m, double ml, int maxLevel,
 
 	element->level = level;
 	element->deleted = 0;
+	element->sq8Error = 0;
 	/* Start at one to make it easier to find issues */
 	element->version = 1;
 
@@ -281,20 +597,23 @@ HnswInitElementFromBlock(BlockNumber blkno, OffsetNumber offno)
 
 	element->blkno = blkno;
 	element->offno = offno;
+	element->sq8Error = 0;
 	HnswPtrStore(base, element->neighbors, (HnswNeighborArrayPtr *) NULL);
 	HnswPtrStore(base, element->value, (Pointer) NULL);
 	return element;
 }
 
 /*
- * Get the metapage info
+ * Get the metapage info, returning false if the metapage has no cache
+ * versions
  */
-void
-HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint)
+bool
+HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint, uint32 *cacheVersion, uint32 *upperVersion)
 {
 	Buffer		buf;
 	Page		page;
 	HnswMetaPage metap;
+	bool		hasCacheVersion;
 
 	buf = ReadBuffer(index, HNSW_METAPAGE_BLKNO);
 	LockBuffer(buf, BUFFER_LOCK_SHARE);
@@ -304,6 +623,8 @@ HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint)
 	if (unlikely(metap->magicNumber != HNSW_MAGIC_NUMBER))
 		elog(ERROR, "hnsw index is not valid");
 
+	hasCacheVersion = ((PageHeader) page)->pd_lower >= HnswMetaPageLower(page);
+
 	if (m != NULL)
 		*m = metap->m;
 
@@ -318,7 +639,15 @@ HnswGetMetaPageInfo(Relation index, int *m, HnswElement * entryPoint)
 			*entryPoint = NULL;
 	}
 
+	if (cacheVersion != NULL)
+		*cacheVersion = metap->cacheVersion;
+
+	if (upperVersion != NULL)
+		*upperVersion = metap->upperVersion;
+
 	UnlockReleaseBuffer(buf);
+
+	return hasCacheVersion;
 }
 
 /*
@@ -329,7 +658,7 @@ HnswGetEntryPoint(Relation index)
 {
 	HnswElement entryPoint;
 
-	HnswGetMetaPageInfo(index, NULL, &entryPoint);
+	HnswGetMetaPageInfo(index, NULL, &entryPoint, NULL, NULL);
 
 	return entryPoint;
 }
@@ -337,11 +666,14 @@ HnswGetEntryPoint(Relation index)
 /*
  * Update the metapage info
  */
-static void
+void
 HnswUpdateMetaPageInfo(Page page, int updateEntry, HnswElement entryPoint, BlockNumber insertPage)
 {
 	HnswMetaPage metap = HnswPageGetMeta(page);
 
+	/* Set cache versions for indexes created before 0.8.1 */
+	HnswUpgradeMetaPage(page);
+
 	if (updateEntry)
 	{
 		if (entryPoint == NULL)
@@ -421,11 +753,78 @@ HnswFormIndexValue(Datum *out, Datum *values, bool *isnull, const HnswTypeInfo *
 	return true;
 }
 
+/*
+ * Copy a value followed by an attributes tuple
+ */
+static Pointer
+HnswCombineAttrs(Pointer value, IndexTuple attrs)
+{
+	Size		valueSize = VARSIZE_ANY(value);
+	Pointer		result = palloc0(MAXALIGN(valueSize) + IndexTupleSize(attrs));
+
+	memcpy(result, value, valueSize);
+	memcpy(HnswValueAttrs(result), attrs, IndexTupleSize(attrs));
+	return result;
+}
+
+/*
+ * Append the other columns to the value
+ */
+Datum
+HnswAppendAttrs(Relation index, Datum value, Datum *values, bool *isnull)
+{
+	TupleDesc	tupdesc = RelationGetDescr(index);
+	bool	   *attrsIsnull = palloc(tupdesc->natts * sizeof(bool));
+	IndexTuple	attrs;
+
+	/* Value is stored separately */
+	memcpy(attrsIsnull, isnull, tupdesc->natts * sizeof(bool));
+	attrsIsnull[0] = true;
+
+	attrs = index_form_tuple(tupdesc, values, attrsIsnull);
+
+	return PointerGetDatum(HnswCombineAttrs(DatumGetPointer(value), attrs));
+}
+
+/*
+ * Check if the other columns are equal
+ */
+bool
+HnswAttrsEqual(Datum a, Datum b)
+{
+	IndexTuple	attrsA = HnswValueAttrs(DatumGetPointer(a));
+	IndexTuple	attrsB = HnswValueAttrs(DatumGetPointer(b));
+
+	if (IndexTupleSize(attrsA) != IndexTupleSize(attrsB))
+		return false;
+
+	return memcmp(attrsA, attrsB, IndexTupleSize(attrsA)) == 0;
+}
+
+/*
+ * Get the size of the value in an element tuple
+ */
+Size
+HnswElementDataSize(Pointer value, bool sq8, bool attrs)
+{
+	Size		size;
+
+	if (sq8)
+		size = HNSW_SQ8_SIZE(((Vector *) value)->dim);
+	else
+		size = VARSIZE_ANY(value);
+
+	if (attrs)
+		size = MAXALIGN(size) + IndexTupleSize(HnswValueAttrs(value));
+
+	return size;
+}
+
 /*
  * Set element tuple, except for neighbor info
  */
 void
-HnswSetElementTuple(char *base, HnswElementTuple etup, HnswElement element)
+HnswSetElementTuple(char *base, HnswElementTuple etup, HnswElement element, bool sq8, bool attrs)
 {
 	Pointer		valuePtr = HnswPtrAccess(base, element->value);
 
@@ -440,7 +839,25 @@ HnswSetElementTuple(char *base, HnswElementTuple etup, HnswElement element)
 		else
 			ItemPointerSetInvalid(&etup->heaptids[i]);
 	}
-	memcpy(&etup->data, valuePtr, VARSIZE_ANY(valuePtr));
+
+	if (sq8)
+	{
+		etup->flags = HNSW_ELEMENT_SQ8;
+		HnswQuantizeSq8((Vector *) valuePtr, (HnswSq8Vector *) &etup->data);
+	}
+	else
+	{
+		etup->flags = 0;
+		memcpy(&etup->data, valuePtr, VARSIZE_ANY(valuePtr));
+	}
+
+	if (attrs)
+	{
+		IndexTuple	valueAttrs = HnswValueAttrs(valuePtr);
+
+		etup->flags |= HNSW_ELEMENT_ATTRS;
+		memcpy(HnswElementTupleAttrs(etup), valueAttrs, IndexTupleSize(valueAttrs));
+	}
 }
 
 /*
@@ -490,6 +907,7 @@ HnswLoadElementFromTuple(HnswElement element, HnswElementTuple etup, bool loadHe
 	element->neighborPage = ItemPointerGetBlockNumber(&etup->neighbortid);
 	element->neighborOffno = ItemPointerGetOffsetNumber(&etup->neighbortid);
 	element->heaptidsLength = 0;
+	element->sq8Error = (etup->flags & HNSW_ELEMENT_SQ8) ? HnswGetSq8Error((HnswSq8Vector *) &etup->data) : 0;
 
 	if (loadHeaptids)
 	{
@@ -506,37 +924,80 @@ HnswLoadElementFromTuple(HnswElement element, HnswElementTuple etup, bool loadHe
 	if (loadVec)
 	{
 		char	   *base = NULL;
-		Datum		value = datumCopy(PointerGetDatum(&etup->data), false, -1);
+		Datum		value;
+
+		if (etup->flags & HNSW_ELEMENT_SQ8)
+			value = PointerGetDatum(HnswDequantizeSq8((HnswSq8Vector *) &etup->data));
+		else
+			value = datumCopy(PointerGetDatum(&etup->data), false, -1);
+
+		/* Keep other columns with the value */
+		if (etup->flags & HNSW_ELEMENT_ATTRS)
+			value = PointerGetDatum(HnswCombineAttrs(DatumGetPointer(value), HnswElementTupleAttrs(etup)));
 
 		HnswPtrStore(base, element->value, DatumGetPointer(value));
 	}
 }
 
 /*
- * Calculate the distance between values
+ * Calculate the distance between a value and 8-bit codes
  */
 static inline double
-HnswGetDistance(Datum a, Datum b, HnswSupport * support)
+HnswGetSq8Distance(Datum a, HnswSq8Vector * b, HnswSupport * support)
 {
-	return DatumGetFloat8(FunctionCall2Coll(support->procinfo, support->collation, a, b));
+	if (support->sq8Kernel != NULL)
+	{
+		IndexStatsCount(INDEX_STATS_DISTANCES, 1);
+		return support->sq8Kernel(a, PointerGetDatum(b));
+	}
+
+	return HnswGetDistance(a, PointerGetDatum(HnswDequantizeSq8(b)), support);
 }
 
 /*
- * Load an element and optionally get its distance from q
+ * Check if an element tuple matches the filter of the query
  */
-static void
-HnswLoadElementImpl(BlockNumber blkno, OffsetNumber offno, double *distance, HnswQuery * q, Relation index, HnswSupport * support, bool loadVec, double *maxDistance, HnswElement * element)
+static bool
+HnswMatchesFilter(HnswQuery * q, HnswElementTuple etup)
 {
-	Buffer		buf;
-	Page		page;
-	HnswElementTuple etup;
+	IndexTuple	attrs;
 
-	/* Read vector */
-	buf = ReadBuffer(index, blkno);
-	LockBuffer(buf, BUFFER_LOCK_SHARE);
-	page = BufferGetPage(buf);
+	if (q == NULL || q->nkeys == 0)
+		return true;
+
+	if (!(etup->flags & HNSW_ELEMENT_ATTRS))
+		return false;
+
+	attrs = HnswElementTupleAttrs(etup);
+
+	for (int i = 0; i < q->nkeys; i++)
+	{
+		ScanKey		key = &q->keys[i];
+		Datum		datum;
+		bool		isnull;
+
+		/* Operators are strict */
+		if (key->sk_flags & SK_ISNULL)
+			return false;
 
-	etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, offno));
+		datum = index_getattr(attrs, key->sk_attno, q->tupdesc, &isnull);
+		if (isnull)
+			return false;
+
+		if (!DatumGetBool(FunctionCall2Coll(&key->sk_func, key->sk_collation, datum, key->sk_argument)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Load an element from a locked page and optionally get its distance from q
+ */
+static void
+HnswLoadElementFromPage(Page page, BlockNumber blkno, OffsetNumber offno, double *distance, HnswQuery * q, HnswSupport * support, bool loadVec, double *maxDistance, HnswElement * element)
+{
+	HnswElementTuple etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, offno));
 
 	Assert(HnswIsElementTuple(etup));
 
@@ -545,6 +1006,8 @@ HnswLoadElementImpl(BlockNumber blkno, OffsetNumber offno, double *distance, Hns
 	{
 		if (DatumGetPointer(q->value) == NULL)
 			*distance = 0;
+		else if (etup->flags & HNSW_ELEMENT_SQ8)
+			*distance = HnswGetSq8Distance(q->value, (HnswSq8Vector *) &etup->data, support);
 		else
 			*distance = HnswGetDistance(q->value, PointerGetDatum(&etup->data), support);
 	}
@@ -555,8 +1018,25 @@ HnswLoadElementImpl(BlockNumber blkno, OffsetNumber offno, double *distance, Hns
 		if (*element == NULL)
 			*element = HnswInitElementFromBlock(blkno, offno);
 
-		HnswLoadElementFromTuple(*element, etup, true, loadVec);
+		/* Elements not matching the filter are only used for navigation */
+		HnswLoadElementFromTuple(*element, etup, HnswMatchesFilter(q, etup), loadVec);
 	}
+}
+
+/*
+ * Load an element and optionally get its distance from q
+ */
+static void
+HnswLoadElementImpl(BlockNumber blkno, OffsetNumber offno, double *distance, HnswQuery * q, Relation index, HnswSupport * support, bool loadVec, double *maxDistance, HnswElement * element)
+{
+	Buffer		buf;
+
+	/* Read vector */
+	buf = ReadBuffer(index, blkno);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
+
+	HnswLoadElementFromPage(BufferGetPage(buf), blkno, offno, distance, q, support, loadVec, maxDistance, element);
 
 	UnlockReleaseBuffer(buf);
 }
@@ -612,48 +1092,104 @@ HnswEntryCandidate(char *base, HnswElement entryPoint, HnswQuery * q, Relation i
 }
 
 /*
- * Compare candidate distances
+ * Compare discarded candidate distances
  */
 static int
-CompareNearestCandidates(const pairingheap_node *a, const pairingheap_node *b, void *arg)
+CompareNearestDiscardedCandidates(const pairingheap_node *a, const pairingheap_node *b, void *arg)
 {
-	if (HnswGetSearchCandidateConst(c_node, a)->distance < HnswGetSearchCandidateConst(c_node, b)->distance)
+	if (HnswGetSearchCandidateConst(w_node, a)->distance < HnswGetSearchCandidateConst(w_node, b)->distance)
 		return 1;
 
-	if (HnswGetSearchCandidateConst(c_node, a)->distance > HnswGetSearchCandidateConst(c_node, b)->distance)
+	if (HnswGetSearchCandidateConst(w_node, a)->distance > HnswGetSearchCandidateConst(w_node, b)->distance)
 		return -1;
 
 	return 0;
 }
 
 /*
- * Compare discarded candidate distances
+ * Initialize a candidate queue
  */
-static int
-CompareNearestDiscardedCandidates(const pairingheap_node *a, const pairingheap_node *b, void *arg)
+static void
+HnswQueueInit(HnswQueue * queue, int capacity, bool furthestFirst)
 {
-	if (HnswGetSearchCandidateConst(w_node, a)->distance < HnswGetSearchCandidateConst(w_node, b)->distance)
-		return 1;
+	queue->items = palloc(capacity * sizeof(HnswQueueItem));
+	queue->length = 0;
+	queue->capacity = capacity;
+	queue->furthestFirst = furthestFirst;
+}
 
-	if (HnswGetSearchCandidateConst(w_node, a)->distance > HnswGetSearchCandidateConst(w_node, b)->distance)
-		return -1;
+/*
+ * Check if a distance should come before another in the queue
+ */
+static inline bool
+HnswQueueBefore(HnswQueue * queue, double a, double b)
+{
+	return queue->furthestFirst ? a > b : a < b;
+}
 
-	return 0;
+/*
+ * Add a candidate to the queue
+ */
+static void
+HnswQueuePush(HnswQueue * queue, HnswElementPtr element, double distance)
+{
+	int			i;
+
+	if (queue->length == queue->capacity)
+	{
+		queue->capacity *= 2;
+		queue->items = repalloc(queue->items, queue->capacity * sizeof(HnswQueueItem));
+	}
+
+	/* Sift up */
+	i = queue->length++;
+	while (i > 0)
+	{
+		int			parent = (i - 1) / 2;
+
+		if (!HnswQueueBefore(queue, distance, queue->items[parent].distance))
+			break;
+
+		queue->items[i] = queue->items[parent];
+		i = parent;
+	}
+
+	queue->items[i].element = element;
+	queue->items[i].distance = distance;
 }
 
 /*
- * Compare candidate distances
+ * Remove the first candidate from the queue
  */
-static int
-CompareFurthestCandidates(const pairingheap_node *a, const pairingheap_node *b, void *arg)
+static HnswQueueItem
+HnswQueuePop(HnswQueue * queue)
 {
-	if (HnswGetSearchCandidateConst(w_node, a)->distance < HnswGetSearchCandidateConst(w_node, b)->distance)
-		return -1;
+	HnswQueueItem first = queue->items[0];
+	HnswQueueItem last = queue->items[--queue->length];
+	int			i = 0;
 
-	if (HnswGetSearchCandidateConst(w_node, a)->distance > HnswGetSearchCandidateConst(w_node, b)->distance)
-		return 1;
+	/* Sift down */
+	for (;;)
+	{
+		int			child = 2 * i + 1;
 
-	return 0;
+		if (child >= queue->length)
+			break;
+
+		if (child + 1 < queue->length && HnswQueueBefore(queue, queue->items[child + 1].distance, queue->items[child].distance))
+			child++;
+
+		if (!HnswQueueBefore(queue, queue->items[child].distance, last.distance))
+			break;
+
+		queue->items[i] = queue->items[child];
+		i = child;
+	}
+
+	if (queue->length > 0)
+		queue->items[i] = last;
+
+	return first;
 }
 
 /*
@@ -664,10 +1200,20 @@ InitVisited(char *base, visited_hash * v, bool inMemory, int ef, int m)
 {
 	if (!inMemory)
 		v->tids = tidhash_create(CurrentMemoryContext, ef * m * 2, NULL);
-	else if (base != NULL)
-		v->offsets = offsethash_create(CurrentMemoryContext, ef * m * 2, NULL);
 	else
-		v->pointers = pointerhash_create(CurrentMemoryContext, ef * m * 2, NULL);
+	{
+		HnswVisitedArray *visited = v->array;
+
+		/* Start a new generation instead of clearing */
+		visited->generation++;
+
+		/* Clear on wraparound */
+		if (visited->generation == 0)
+		{
+			memset(visited->generations, 0, visited->length * sizeof(uint32));
+			visited->generation = 1;
+		}
+	}
 }
 
 /*
@@ -684,17 +1230,23 @@ AddToVisited(char *base, visited_hash * v, HnswElementPtr elementPtr, bool inMem
 		ItemPointerSet(&indextid, element->blkno, element->offno);
 		tidhash_insert(v->tids, indextid, found);
 	}
-	else if (base != NULL)
-	{
-		HnswElement element = HnswPtrAccess(base, elementPtr);
-
-		offsethash_insert_hash(v->offsets, HnswPtrOffset(elementPtr), element->hash, found);
-	}
 	else
 	{
 		HnswElement element = HnswPtrAccess(base, elementPtr);
+		HnswVisitedArray *visited = v->array;
+
+		/* Other processes may have added elements in a parallel build */
+		if (element->id >= visited->length)
+		{
+			uint32		length = Max(visited->length * 2, element->id + 1);
+
+			visited->generations = repalloc(visited->generations, length * sizeof(uint32));
+			memset(visited->generations + visited->length, 0, (length - visited->length) * sizeof(uint32));
+			visited->length = length;
+		}
 
-		pointerhash_insert_hash(v->pointers, (uintptr_t) HnswPtrPointer(elementPtr), element->hash, found);
+		*found = visited->generations[element->id] == visited->generation;
+		visited->generations[element->id] = visited->generation;
 	}
 }
 
@@ -702,9 +1254,9 @@ AddToVisited(char *base, visited_hash * v, HnswElementPtr elementPtr, bool inMem
  * Count element towards ef
  */
 static inline bool
-CountElement(HnswElement skipElement, HnswElement e)
+CountElement(bool filtered, HnswElement e)
 {
-	if (skipElement == NULL)
+	if (!filtered)
 		return true;
 
 	/* Ensure does not access heaptidsLength during in-memory build */
@@ -748,15 +1300,20 @@ HnswLoadUnvisitedFromMemory(char *base, HnswElement element, HnswUnvisited * unv
  * Load neighbor index TIDs
  */
 bool
-HnswLoadNeighborTids(HnswElement element, ItemPointerData *indextids, Relation index, int m, int lm, int lc)
+HnswLoadNeighborTids(HnswElement element, ItemPointerData *indextids, Relation index, int m, int lm, int lc, uint32 *cacheVersion)
 {
 	Buffer		buf;
 	Page		page;
 	HnswNeighborTuple ntup;
 	int			start;
 
+	/* Skip the page if another backend cached the list */
+	if (cacheVersion != NULL && HnswSharedCacheGet(index, element, lc, *cacheVersion, indextids, lm))
+		return true;
+
 	buf = ReadBuffer(index, element->neighborPage);
 	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
 	page = BufferGetPage(buf);
 
 	ntup = (HnswNeighborTuple) PageGetItem(page, PageGetItemId(page, element->neighborOffno));
@@ -775,21 +1332,62 @@ HnswLoadNeighborTids(HnswElement element, ItemPointerData *indextids, Relation i
 	start = (element->level - lc) * m;
 	memcpy(indextids, ntup->indextids + start, lm * sizeof(ItemPointerData));
 
+	/* Cache while locked so concurrent updates are not overwritten */
+	if (cacheVersion != NULL)
+		HnswSharedCachePut(index, element, lc, *cacheVersion, indextids, lm, PageGetLSN(page));
+
 	UnlockReleaseBuffer(buf);
 	return true;
 }
 
+/*
+ * Compare unvisited index TIDs
+ */
+static int
+CompareUnvisitedTids(const void *a, const void *b)
+{
+	return ItemPointerCompare(&((HnswUnvisited *) a)->indextid, &((HnswUnvisited *) b)->indextid);
+}
+
+/*
+ * Prefetch pages for unvisited neighbors
+ */
+static void
+HnswPrefetchUnvisited(HnswUnvisited * unvisited, int unvisitedLength, Relation index)
+{
+	BlockNumber lastBlkno = InvalidBlockNumber;
+	int			prefetched = 0;
+
+	for (int i = 0; i < unvisitedLength && prefetched < hnsw_prefetch_depth; i++)
+	{
+		BlockNumber blkno = ItemPointerGetBlockNumber(&unvisited[i].indextid);
+
+		if (blkno == lastBlkno)
+			continue;
+
+		/* First page is read immediately */
+		if (BlockNumberIsValid(lastBlkno))
+		{
+			PrefetchBuffer(index, MAIN_FORKNUM, blkno);
+			prefetched++;
+		}
+
+		lastBlkno = blkno;
+	}
+}
+
 /*
  * Load unvisited neighbors from disk
  */
 static void
-HnswLoadUnvisitedFromDisk(HnswElement element, HnswUnvisited * unvisited, int *unvisitedLength, visited_hash * v, Relation index, int m, int lm, int lc)
+HnswLoadUnvisitedFromDisk(HnswElement element, HnswUnvisited * unvisited, int *unvisitedLength, int *neighborsLength, visited_hash * v, Relation index, int m, int lm, int lc, uint32 *cacheVersion)
 {
 	ItemPointerData indextids[HNSW_MAX_M * 2];
 
 	*unvisitedLength = 0;
+	*neighborsLength = 0;
 
-	if (!HnswLoadNeighborTids(element, indextids, index, m, lm, lc))
+	if (!HnswLoadNeighborTids(element, indextids, index, m, lm, lc, cacheVersion))
 		return;
 
 	for (int i = 0; i < lm; i++)
@@ -800,11 +1398,100 @@ HnswLoadUnvisitedFromDisk(HnswElement element, HnswUnvisited * unvisited, int *u
 		if (!ItemPointerIsValid(indextid))
 			break;
 
+		(*neighborsLength)++;
+
 		tidhash_insert(v->tids, *indextid, &found);
 
 		if (!found)
 			unvisited[(*unvisitedLength)++].indextid = *indextid;
 	}
+
+	/* Group by block so each page is only read once */
+	if (*unvisitedLength > 1)
+	{
+		qsort(unvisited, *unvisitedLength, sizeof(HnswUnvisited), CompareUnvisitedTids);
+
+		if (hnsw_prefetch_depth > 0)
+			HnswPrefetchUnvisited(unvisited, *unvisitedLength, index);
+	}
+}
+
+/*
+ * Add to the nearest k if closer than the furthest
+ */
+static bool
+PushTopK(HnswQueue * T, int k, HnswElementPtr element, double distance)
+{
+	if (T->length >= k && distance >= T->items[0].distance)
+		return false;
+
+	HnswQueuePush(T, element, distance);
+
+	if (T->length > k)
+		HnswQueuePop(T);
+
+	return true;
+}
+
+/*
+ * Compare queue items by element
+ */
+static int
+CompareQueueItemElements(const void *a, const void *b, void *arg)
+{
+	char	   *base = (char *) arg;
+	HnswElement ea = HnswPtrAccess(base, ((const HnswQueueItem *) a)->element);
+	HnswElement eb = HnswPtrAccess(base, ((const HnswQueueItem *) b)->element);
+
+	if (ea < eb)
+		return -1;
+
+	if (ea > eb)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Move candidates in W that were not expanded to discarded
+ *
+ * Candidates in C that are no longer in W were already discarded.
+ */
+static void
+DiscardUnexpanded(char *base, HnswQueue * C, HnswQueue * W, pairingheap *discarded)
+{
+	HnswQueueItem *items = palloc(W->length * sizeof(HnswQueueItem));
+	int			length = W->length;
+
+	memcpy(items, W->items, length * sizeof(HnswQueueItem));
+	qsort_arg(C->items, C->length, sizeof(HnswQueueItem), CompareQueueItemElements, base);
+
+	W->length = 0;
+	for (int i = 0; i < length; i++)
+	{
+		HnswElement element = HnswPtrAccess(base, items[i].element);
+		int			lo = 0;
+		int			hi = C->length;
+
+		/* Binary search C for the element */
+		while (lo < hi)
+		{
+			int			mid = lo + (hi - lo) / 2;
+
+			if (HnswPtrAccess(base, C->items[mid].element) < element)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo < C->length && HnswPtrAccess(base, C->items[lo].element) == element)
+			pairingheap_add(discarded, &HnswInitSearchCandidate(base, element, items[i].distance)->w_node);
+		else
+			HnswQueuePush(W, items[i].element, items[i].distance);
+	}
+
+	C->length = 0;
+	pfree(items);
 }
 
 /*
@@ -814,8 +1501,9 @@ List *
 HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation index, HnswSupport * support, int m, bool inserting, HnswElement skipElement, visited_hash * v, pairingheap **discarded, bool initVisited, int64 *tuples)
 {
 	List	   *w = NIL;
-	pairingheap *C = pairingheap_allocate(CompareNearestCandidates, NULL);
-	pairingheap *W = pairingheap_allocate(CompareFurthestCandidates, NULL);
+	HnswQueue	C;
+	HnswQueue	W;
+	HnswQueue	T;
 	int			wlen = 0;
 	visited_hash vh;
 	ListCell   *lc2;
@@ -824,7 +1512,33 @@ HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation in
 	int			lm = HnswGetLayerM(m, lc);
 	HnswUnvisited *unvisited = palloc(lm * sizeof(HnswUnvisited));
 	int			unvisitedLength;
+	int			neighborsLength;
 	bool		inMemory = index == NULL;
+	Datum	   *unvisitedValues = inMemory ? palloc(lm * sizeof(Datum)) : NULL;
+	double	   *unvisitedDistances = inMemory ? palloc(lm * sizeof(double)) : NULL;
+	Buffer		buf = InvalidBuffer;
+
+	/* Inserts need the latest neighbors, so only scans use the shared cache */
+	uint32	   *cacheVersion = inserting || !q->sharedCache ? NULL : &q->cacheVersion;
+
+	/* Scans stop at the ground layer once candidates are outside the radius */
+	double		maxDistance = inserting || lc > 0 ? get_float8_infinity() : q->maxDistance;
+
+	/* Scans can also stop once expansions no longer improve the top k */
+	int			patience = inserting || lc > 0 ? 0 : hnsw_search_patience;
+	int			k = !inserting && q->limit > 0 ? Min(q->limit, ef) : ef;
+	int			stalled = 0;
+
+	/* Only scans are traced */
+	HnswSearchTraceCallback trace = inserting ? NULL : q->trace;
+
+	/*
+	 * Do not count elements being deleted towards ef when vacuuming. It would
+	 * be ideal to do this for inserts as well, but this could affect insert
+	 * performance. Elements that do not match the filter are also not counted
+	 * at the ground layer, so they are only used for navigation.
+	 */
+	bool		filtered = skipElement != NULL || (lc == 0 && q->nkeys > 0);
 
 	if (v == NULL)
 	{
@@ -847,6 +1561,13 @@ HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation in
 		localNeighborhood = palloc(neighborhoodSize);
 	}
 
+	/* Size queues for the common case and grow if needed */
+	HnswQueueInit(&C, Max(ef, list_length(ep)) + lm, false);
+	HnswQueueInit(&W, Max(ef, list_length(ep)) + 1, true);
+
+	/* Track the nearest k results to detect when expansions stall */
+	HnswQueueInit(&T, patience > 0 ? k + 1 : 1, true);
+
 	/* Add entry points to v, C, and W */
 	foreach(lc2, ep)
 	{
@@ -862,51 +1583,84 @@ HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation in
 				(*tuples)++;
 		}
 
-		pairingheap_add(C, &sc->c_node);
-		pairingheap_add(W, &sc->w_node);
+		HnswQueuePush(&C, sc->element, sc->distance);
+		HnswQueuePush(&W, sc->element, sc->distance);
 
-		/*
-		 * Do not count elements being deleted towards ef when vacuuming. It
-		 * would be ideal to do this for inserts as well, but this could
-		 * affect insert performance.
-		 */
-		if (CountElement(skipElement, HnswPtrAccess(base, sc->element)))
+		if (CountElement(filtered, HnswPtrAccess(base, sc->element)))
+		{
 			wlen++;
+
+			if (patience > 0)
+				PushTopK(&T, k, sc->element, sc->distance);
+		}
 	}
 
-	while (!pairingheap_is_empty(C))
+	while (C.length > 0)
 	{
-		HnswSearchCandidate *c = HnswGetSearchCandidate(c_node, pairingheap_remove_first(C));
-		HnswSearchCandidate *f = HnswGetSearchCandidate(w_node, pairingheap_first(W));
+		HnswQueueItem c = HnswQueuePop(&C);
 		HnswElement cElement;
+		bool		improved = false;
 
-		if (c->distance > f->distance)
+		if (c.distance > W.items[0].distance)
 			break;
 
-		cElement = HnswPtrAccess(base, c->element);
+		/* Remaining candidates are outside the radius */
+		if (c.distance > maxDistance)
+			break;
+
+		/* Bound the work for selective filters, even without iterative scans */
+		if (filtered && tuples != NULL && *tuples >= hnsw_max_scan_tuples)
+			break;
+
+		if (patience > 0 && stalled >= patience)
+		{
+			/* Keep unexpanded candidates so iterative scans can expand them */
+			if (discarded != NULL)
+			{
+				HnswQueuePush(&C, c.element, c.distance);
+				DiscardUnexpanded(base, &C, &W, *discarded);
+			}
+			break;
+		}
+
+		cElement = HnswPtrAccess(base, c.element);
+
+		/* Start reading the neighbor page for the next candidate */
+		if (!inMemory && hnsw_prefetch_depth > 0 && C.length > 0)
+			PrefetchBuffer(index, MAIN_FORKNUM, HnswPtrAccess(base, C.items[0].element)->neighborPage);
 
 		if (inMemory)
+		{
 			HnswLoadUnvisitedFromMemory(base, cElement, unvisited, &unvisitedLength, v, lc, localNeighborhood, neighborhoodSize);
+			neighborsLength = localNeighborhood->length;
+
+			/* Score all unvisited elements at once */
+			for (int i = 0; i < unvisitedLength; i++)
+				unvisitedValues[i] = HnswGetValue(base, unvisited[i].element);
+
+			HnswGetDistances(q->value, unvisitedValues, unvisitedLength, unvisitedDistances, support);
+		}
 		else
-			HnswLoadUnvisitedFromDisk(cElement, unvisited, &unvisitedLength, v, index, m, lm, lc);
+			HnswLoadUnvisitedFromDisk(cElement, unvisited, &unvisitedLength, &neighborsLength, v, index, m, lm, lc, cacheVersion);
 
 		/* OK to count elements instead of tuples */
 		if (tuples != NULL)
 			(*tuples) += unvisitedLength;
 
+		IndexStatsCount(INDEX_STATS_TUPLES_VISITED, unvisitedLength);
+
 		for (int i = 0; i < unvisitedLength; i++)
 		{
 			HnswElement eElement;
-			HnswSearchCandidate *e;
+			HnswElementPtr ePtr;
 			double		eDistance;
+			double		fDistance = W.items[0].distance;
 			bool		alwaysAdd = wlen < ef;
 
-			f = HnswGetSearchCandidate(w_node, pairingheap_first(W));
-
 			if (inMemory)
 			{
 				eElement = unvisited[i].element;
-				eDistance = GetElementDistance(base, eElement, q, support);
+				eDistance = unvisitedDistances[i];
 			}
 			else
 			{
@@ -914,20 +1668,47 @@ HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation in
 				BlockNumber blkno = ItemPointerGetBlockNumber(indextid);
 				OffsetNumber offno = ItemPointerGetOffsetNumber(indextid);
 
+				/* Keep the page locked while neighbors are on the same block */
+				if (!BufferIsValid(buf) || BufferGetBlockNumber(buf) != blkno)
+				{
+					if (BufferIsValid(buf))
+						UnlockReleaseBuffer(buf);
+
+					buf = ReadBuffer(index, blkno);
+					LockBuffer(buf, BUFFER_LOCK_SHARE);
+					IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
+				}
+
 				/* Avoid any allocations if not adding */
 				eElement = NULL;
-				HnswLoadElementImpl(blkno, offno, &eDistance, q, index, support, inserting, alwaysAdd || discarded != NULL ? NULL : &f->distance, &eElement);
+				HnswLoadElementFromPage(BufferGetPage(buf), blkno, offno, &eDistance, q, support, inserting, alwaysAdd ? NULL : &fDistance, &eElement);
 
 				if (eElement == NULL)
+				{
+					/* Keep only the location, and load the element if resumed */
+					if (discarded != NULL)
+					{
+						Page		page = BufferGetPage(buf);
+						HnswElementTuple etup = (HnswElementTuple) PageGetItem(page, PageGetItemId(page, offno));
+						HnswSearchCandidate *e = HnswInitSearchCandidate(base, NULL, eDistance);
+
+						e->blkno = blkno;
+						e->offno = offno;
+						e->version = etup->version;
+						pairingheap_add(*discarded, &e->w_node);
+					}
+
 					continue;
+				}
 			}
 
-			if (eElement == NULL || !(eDistance < f->distance || alwaysAdd))
+			if (eElement == NULL || !(eDistance < fDistance || alwaysAdd))
 			{
 				if (discarded != NULL)
 				{
 					/* Create a new candidate */
-					e = HnswInitSearchCandidate(base, eElement, eDistance);
+					HnswSearchCandidate *e = HnswInitSearchCandidate(base, eElement, eDistance);
+
 					pairingheap_add(*discarded, &e->w_node);
 				}
 
@@ -938,40 +1719,72 @@ HnswSearchLayer(char *base, HnswQuery * q, List *ep, int ef, int lc, Relation in
 			if (eElement->level < lc)
 				continue;
 
-			/* Create a new candidate */
-			e = HnswInitSearchCandidate(base, eElement, eDistance);
-			pairingheap_add(C, &e->c_node);
-			pairingheap_add(W, &e->w_node);
+			HnswPtrStore(base, ePtr, eElement);
+			HnswQueuePush(&C, ePtr, eDistance);
+			HnswQueuePush(&W, ePtr, eDistance);
 
-			/*
-			 * Do not count elements being deleted towards ef when vacuuming.
-			 * It would be ideal to do this for inserts as well, but this
-			 * could affect insert performance.
-			 */
-			if (CountElement(skipElement, eElement))
+			if (CountElement(filtered, eElement))
 			{
 				wlen++;
 
+				if (patience > 0 && PushTopK(&T, k, ePtr, eDistance))
+					improved = true;
+
 				/* No need to decrement wlen */
 				if (wlen > ef)
 				{
-					HnswSearchCandidate *d = HnswGetSearchCandidate(w_node, pairingheap_remove_first(W));
+					HnswQueueItem d = HnswQueuePop(&W);
 
+					/* Only allocate a candidate when keeping it */
 					if (discarded != NULL)
-						pairingheap_add(*discarded, &d->w_node);
+					{
+						HnswSearchCandidate *dc = HnswInitSearchCandidate(base, HnswPtrAccess(base, d.element), d.distance);
+
+						pairingheap_add(*discarded, &dc->w_node);
+					}
 				}
 			}
 		}
+
+		if (BufferIsValid(buf))
+		{
+			UnlockReleaseBuffer(buf);
+			buf = InvalidBuffer;
+		}
+
+		if (trace != NULL)
+		{
+			HnswSearchStep step;
+
+			step.layer = lc;
+			step.blkno = cElement->blkno;
+			step.offno = cElement->offno;
+			step.distance = c.distance;
+			step.scored = unvisitedLength;
+			step.skipped = neighborsLength - unvisitedLength;
+			step.boundary = W.items[0].distance;
+			trace(&step, q->traceArg);
+		}
+
+		/* Count expansions in a row that did not change the top k */
+		if (improved || wlen < k)
+			stalled = 0;
+		else
+			stalled++;
 	}
 
 	/* Add each element of W to w */
-	while (!pairingheap_is_empty(W))
+	while (W.length > 0)
 	{
-		HnswSearchCandidate *sc = HnswGetSearchCandidate(w_node, pairingheap_remove_first(W));
+		HnswQueueItem item = HnswQueuePop(&W);
 
-		w = lappend(w, sc);
+		w = lappend(w, HnswInitSearchCandidate(base, HnswPtrAccess(base, item.element), item.distance));
 	}
 
+	pfree(C.items);
+	pfree(W.items);
+	pfree(T.items);
+
 	return w;
 }
 
@@ -1025,23 +1838,37 @@ CompareCandidateDistancesOffset(const ListCell *a, const ListCell *b)
 
 /*
  * Check if an element is closer to q than any element from R
+ *
+ * Distances are calculated in small batches, which still allows returning
+ * early since the closest elements of R come first.
  */
 static bool
 CheckElementCloser(char *base, HnswCandidate * e, List *r, HnswSupport * support)
 {
 	HnswElement eElement = HnswPtrAccess(base, e->element);
 	Datum		eValue = HnswGetValue(base, eElement);
-	ListCell   *lc2;
+	Datum		values[HNSW_DISTANCE_BATCH_SIZE];
+	double		distances[HNSW_DISTANCE_BATCH_SIZE];
+	int			length = list_length(r);
 
-	foreach(lc2, r)
+	for (int i = 0; i < length; i += HNSW_DISTANCE_BATCH_SIZE)
 	{
-		HnswCandidate *ri = lfirst(lc2);
-		HnswElement riElement = HnswPtrAccess(base, ri->element);
-		Datum		riValue = HnswGetValue(base, riElement);
-		float		distance = HnswGetDistance(eValue, riValue, support);
+		int			n = Min(length - i, HNSW_DISTANCE_BATCH_SIZE);
 
-		if (distance <= e->distance)
-			return false;
+		for (int j = 0; j < n; j++)
+		{
+			HnswCandidate *ri = list_nth(r, i + j);
+
+			values[j] = HnswGetValue(base, HnswPtrAccess(base, ri->element));
+		}
+
+		HnswGetDistances(eValue, values, n, distances, support);
+
+		for (int j = 0; j < n; j++)
+		{
+			if ((float) distances[j] <= e->distance)
+				return false;
+		}
 	}
 
 	return true;
@@ -1247,27 +2074,11 @@ RemoveElements(char *base, List *w, HnswElement skipElement)
 	return w2;
 }
 
-/*
- * Precompute hash
- */
-static void
-PrecomputeHash(char *base, HnswElement element)
-{
-	HnswElementPtr ptr;
-
-	HnswPtrStore(base, ptr, element);
-
-	if (base == NULL)
-		element->hash = hash_pointer((uintptr_t) HnswPtrPointer(ptr));
-	else
-		element->hash = hash_offset(HnswPtrOffset(ptr));
-}
-
 /*
  * Algorithm 1 from paper
  */
 void
-HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint, Relation index, HnswSupport * support, int m, int efConstruction, bool existing)
+HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint, Relation index, HnswSupport * support, int m, int efConstruction, bool existing, HnswVisitedArray * visited)
 {
 	List	   *ep;
 	List	   *w;
@@ -1276,12 +2087,19 @@ HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint
 	HnswQuery	q;
 	HnswElement skipElement = existing ? element : NULL;
 	bool		inMemory = index == NULL;
+	visited_hash vh;
+	visited_hash *v = NULL;
 
 	q.value = HnswGetValue(base, element);
+	q.nkeys = 0;
 
-	/* Precompute hash */
+	/* Reuse visited array across layers and inserts */
 	if (inMemory)
-		PrecomputeHash(base, element);
+	{
+		Assert(visited != NULL);
+		vh.array = visited;
+		v = &vh;
+	}
 
 	/* No neighbors if no entry point */
 	if (entryPoint == NULL)
@@ -1294,7 +2112,7 @@ HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint
 	/* 1st phase: greedy search to insert level */
 	for (int lc = entryLevel; lc >= level + 1; lc--)
 	{
-		w = HnswSearchLayer(base, &q, ep, 1, lc, index, support, m, true, skipElement, NULL, NULL, true, NULL);
+		w = HnswSearchLayer(base, &q, ep, 1, lc, index, support, m, true, skipElement, v, NULL, true, NULL);
 		ep = w;
 	}
 
@@ -1313,7 +2131,7 @@ HnswFindElementNeighbors(char *base, HnswElement element, HnswElement entryPoint
 		List	   *lw = NIL;
 		ListCell   *lc2;
 
-		w = HnswSearchLayer(base, &q, ep, efConstruction, lc, index, support, m, true, skipElement, NULL, NULL, true, NULL);
+		w = HnswSearchLayer(base, &q, ep, efConstruction, lc, index, support, m, true, skipElement, v, NULL, true, NULL);
 
 		/* Convert search candidates to candidates */
 		foreach(lc2, w)
@@ -1373,7 +2191,10 @@ HnswGetTypeInfo(Relation index)
 		static const HnswTypeInfo typeInfo = {
 			.maxDimensions = HNSW_MAX_DIM,
 			.normalize = l2_normalize,
-			.checkValue = NULL
+			.checkValue = NULL,
+			.getDistanceKernel = VectorGetDistanceKernel,
+			.getDistanceBatchKernel = VectorGetDistanceBatchKernel,
+			.supportsSq8 = true
 		};
 
 		return (&typeInfo);
@@ -1389,7 +2210,8 @@ hnsw_halfvec_support(PG_FUNCTION_ARGS)
 	static const HnswTypeInfo typeInfo = {
 		.maxDimensions = HNSW_MAX_DIM * 2,
 		.normalize = halfvec_l2_normalize,
-		.checkValue = NULL
+		.checkValue = NULL,
+		.getDistanceKernel = HalfvecGetDistanceKernel
 	};
 
 	PG_RETURN_POINTER(&typeInfo);
@@ -1402,7 +2224,8 @@ hnsw_bit_support(PG_FUNCTION_ARGS)
 	static const HnswTypeInfo typeInfo = {
 		.maxDimensions = HNSW_MAX_DIM * 32,
 		.normalize = NULL,
-		.checkValue = NULL
+		.checkValue = NULL,
+		.getDistanceKernel = BitGetDistanceKernel
 	};
 
 	PG_RETURN_POINTER(&typeInfo);
@@ -1415,7 +2238,8 @@ hnsw_sparsevec_support(PG_FUNCTION_ARGS)
 	static const HnswTypeInfo typeInfo = {
 		.maxDimensions = SPARSEVEC_MAX_DIM,
 		.normalize = sparsevec_l2_normalize,
-		.checkValue = SparsevecCheckValue
+		.checkValue = SparsevecCheckValue,
+		.getDistanceKernel = SparsevecGetDistanceKernel
 	};
 
 	PG_RETURN_POINTER(&typeInfo);
@@ -204,7 +204,7 @@ RepairGraphElement(HnswVacuumState * vacuumstate, HnswElement element, HnswEleme
 	element->heaptidsLength = 0;
 
 	/* Find neighbors for element, skipping itself */
-	HnswFindElementNeighbors(base, element, entryPoint, index, support, m, efConstruction, true);
+	HnswFindElementNeighbors(base, element, entryPoint, index, support, m, efConstruction, true, NULL);
 
 	/* Zero memory for each element */
 	MemSet(ntup, 0, HNSW_TUPLE_ALLOC_SIZE);
@@ -223,6 +223,10 @@ RepairGraphElement(HnswVacuumState * vacuumstate, HnswElement element, HnswEleme
 	if (!PageIndexTupleOverwrite(page, element->neighborOffno, (Item) ntup, ntupSize))
 		elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
 
+	/* Scans in other backends must see the repaired connections */
+	for (int lc = element->level; lc >= 0; lc--)
+		HnswSharedCacheInvalidate(index, element, lc);
+
 	/* Commit */
 	GenericXLogFinish(state);
 	UnlockReleaseBuffer(buf);
@@ -441,6 +445,13 @@ MarkDeleted(HnswVacuumState * vacuumstate)
 	Relation	index = vacuumstate->index;
 	BufferAccessStrategy bas = vacuumstate->bas;
 
+	/*
+	 * Graph data cached by backends may contain tuples about to be deleted,
+	 * so rebuild it from the repaired graph
+	 */
+	if (vacuumstate->deleted->members > 0)
+		HnswInvalidateCache(index);
+
 	/*
 	 * Wait for index scans to complete. Scans before this point may contain
 	 * tuples about to be deleted. Scans after this point will not, since the
@@ -521,7 +532,8 @@ MarkDeleted(HnswVacuumState * vacuumstate)
 
 			/* Overwrite element */
 			etup->deleted = 1;
-			MemSet(&etup->data, 0, VARSIZE_ANY(&etup->data));
+			MemSet(&etup->data, 0, ItemIdGetLength(PageGetItemId(page, offno)) - offsetof(HnswElementTupleData, data));
+			etup->flags = 0;
 
 			/* Overwrite neighbors */
 			for (int i = 0; i < ntup->count; i++)
@@ -589,7 +601,7 @@ InitVacuumState(HnswVacuumState * vacuumstate, IndexVacuumInfo *info, IndexBulkD
 	HnswInitSupport(&vacuumstate->support, index);
 
 	/* Get m from metapage */
-	HnswGetMetaPageInfo(index, &vacuumstate->m, NULL);
+	HnswGetMetaPageInfo(index, &vacuumstate->m, NULL, NULL, NULL);
 
 	/* Create hash table */
 	vacuumstate->deleted = tidhash_create(CurrentMemoryContext, 256, NULL);
@@ -615,6 +627,8 @@ hnswbulkdelete(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 			   IndexBulkDeleteCallback callback, void *callback_state)
 {
 	HnswVacuumState vacuumstate;
+	IndexStatsCounts counts = {0};
+	IndexStatsCounts *prevCounts = IndexStatsBegin(&counts);
 
 	InitVacuumState(&vacuumstate, info, stats, callback, callback_state);
 
@@ -629,6 +643,9 @@ hnswbulkdelete(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 
 	FreeVacuumState(&vacuumstate);
 
+	IndexStatsEnd(prevCounts);
+	IndexStatsFlush(info->index, &counts);
+
 	return vacuumstate.stats;
 }
 
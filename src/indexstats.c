@@ -0,0 +1,404 @@
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_class.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "indexstats.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+#include "utils/rel.h"
+#include "utils/tuplestore.h"
+#include "vector.h"
+
+#define INDEX_STATS_MAX_INDEXES 4096
+#define INDEX_STATS_NAME "vector index stats"
+
+typedef struct IndexStatsKey
+{
+	Oid			dbid;
+	Oid			indexid;
+}			IndexStatsKey;
+
+typedef struct IndexStatsEntry
+{
+	IndexStatsKey key;
+	pg_atomic_uint64 counters[INDEX_STATS_COUNTERS];
+}			IndexStatsEntry;
+
+typedef struct IndexStatsShared
+{
+	LWLock	   *lock;
+	uint64		generation;		/* incremented when entries are removed */
+	bool		full;			/* logged that new indexes are ignored */
+}			IndexStatsShared;
+
+/* Counts outside of a scan or operation, or left by one that errored */
+static IndexStatsCounts discardedCounts;
+
+IndexStatsCounts *IndexStatsCurrent = &discardedCounts;
+
+static IndexStatsShared * indexStats = NULL;
+static HTAB *indexStatsHash = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static object_access_hook_type prev_object_access_hook = NULL;
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+
+/* Last entry used by this backend */
+static Oid	lastIndexId = InvalidOid;
+static uint64 lastGeneration = 0;
+static IndexStatsEntry * lastEntry = NULL;
+
+/*
+ * Get the shared memory size
+ */
+static Size
+IndexStatsShmemSize(void)
+{
+	return add_size(MAXALIGN(sizeof(IndexStatsShared)), hash_estimate_size(INDEX_STATS_MAX_INDEXES, sizeof(IndexStatsEntry)));
+}
+
+/*
+ * Request shared memory and locks
+ */
+static void
+IndexStatsShmemRequest(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(IndexStatsShmemSize());
+	RequestNamedLWLockTranche(INDEX_STATS_NAME, 1);
+}
+
+/*
+ * Attach to shared memory, initializing it if needed
+ */
+static void
+IndexStatsShmemStartup(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	indexStats = ShmemInitStruct(INDEX_STATS_NAME, sizeof(IndexStatsShared), &found);
+	if (!found)
+	{
+		indexStats->lock = &(GetNamedLWLockTranche(INDEX_STATS_NAME))->lock;
+		indexStats->generation = 0;
+		indexStats->full = false;
+	}
+
+	info.keysize = sizeof(IndexStatsKey);
+	info.entrysize = sizeof(IndexStatsEntry);
+	indexStatsHash = ShmemInitHash(INDEX_STATS_NAME " hash", INDEX_STATS_MAX_INDEXES, INDEX_STATS_MAX_INDEXES, &info, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Remove the entry for an index, with the lock held exclusively
+ */
+static void
+IndexStatsRemove(Oid indexid)
+{
+	IndexStatsKey key;
+
+	key.dbid = MyDatabaseId;
+	key.indexid = indexid;
+
+	if (hash_search(indexStatsHash, &key, HASH_REMOVE, NULL) != NULL)
+	{
+		indexStats->generation++;
+		indexStats->full = false;
+	}
+}
+
+/*
+ * Remove the entries of dropped indexes
+ */
+static void
+IndexStatsObjectAccess(ObjectAccessType access, Oid classId, Oid objectId, int subId, void *arg)
+{
+	if (prev_object_access_hook)
+		prev_object_access_hook(access, classId, objectId, subId, arg);
+
+	/* Counts are lost if the drop is rolled back */
+	if (access == OAT_DROP && classId == RelationRelationId && subId == 0 && indexStats != NULL)
+	{
+		LWLockAcquire(indexStats->lock, LW_EXCLUSIVE);
+		IndexStatsRemove(objectId);
+		LWLockRelease(indexStats->lock);
+	}
+}
+
+/*
+ * Stop counting for a scan or operation that errored, since its counts may
+ * be freed
+ */
+static void
+IndexStatsXactCallback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+		IndexStatsCurrent = &discardedCounts;
+}
+
+/*
+ * Same for subtransactions
+ */
+static void
+IndexStatsSubXactCallback(SubXactEvent event, SubTransactionId mySubid, SubTransactionId parentSubid, void *arg)
+{
+	if (event == SUBXACT_EVENT_ABORT_SUB)
+		IndexStatsCurrent = &discardedCounts;
+}
+
+/*
+ * Register callbacks, and reserve shared memory when loaded with
+ * shared_preload_libraries
+ */
+void
+IndexStatsInit(void)
+{
+	RegisterXactCallback(IndexStatsXactCallback, NULL);
+	RegisterSubXactCallback(IndexStatsSubXactCallback, NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = IndexStatsShmemRequest;
+#else
+	IndexStatsShmemRequest();
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = IndexStatsShmemStartup;
+
+	prev_object_access_hook = object_access_hook;
+	object_access_hook = IndexStatsObjectAccess;
+}
+
+/*
+ * Start counting for a scan or operation, returning the previous counts
+ * to restore with IndexStatsEnd
+ */
+IndexStatsCounts *
+IndexStatsBegin(IndexStatsCounts * counts)
+{
+	IndexStatsCounts *prev = IndexStatsCurrent;
+
+	IndexStatsCurrent = counts;
+	return prev;
+}
+
+/*
+ * Resume counting for the previous scan or operation
+ */
+void
+IndexStatsEnd(IndexStatsCounts * prev)
+{
+	IndexStatsCurrent = prev;
+}
+
+/*
+ * Find or create the entry for an index, with the lock held
+ */
+static IndexStatsEntry *
+IndexStatsGetEntry(Relation index, bool *logFull)
+{
+	IndexStatsKey key;
+	IndexStatsEntry *entry;
+	bool		found;
+
+	if (lastEntry != NULL && lastIndexId == RelationGetRelid(index) && lastGeneration == indexStats->generation)
+		return lastEntry;
+
+	key.dbid = MyDatabaseId;
+	key.indexid = RelationGetRelid(index);
+
+	entry = hash_search(indexStatsHash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		/* Upgrade to an exclusive lock to add the entry */
+		LWLockRelease(indexStats->lock);
+		LWLockAcquire(indexStats->lock, LW_EXCLUSIVE);
+
+		/* Ignore new indexes when full */
+		entry = hash_search(indexStatsHash, &key, HASH_ENTER_NULL, &found);
+		if (entry == NULL)
+		{
+			if (!indexStats->full)
+			{
+				indexStats->full = true;
+				*logFull = true;
+			}
+		}
+		else if (!found)
+		{
+			for (int i = 0; i < INDEX_STATS_COUNTERS; i++)
+				pg_atomic_init_u64(&entry->counters[i], 0);
+		}
+	}
+
+	lastIndexId = key.indexid;
+	lastGeneration = indexStats->generation;
+	lastEntry = entry;
+	return entry;
+}
+
+/*
+ * Add the counts of a scan or operation to an index
+ */
+void
+IndexStatsFlush(Relation index, IndexStatsCounts * counts)
+{
+	IndexStatsEntry *entry;
+	bool		pending = false;
+	bool		logFull = false;
+
+	for (int i = 0; i < INDEX_STATS_COUNTERS; i++)
+	{
+		if (counts->counts[i] != 0)
+		{
+			pending = true;
+			break;
+		}
+	}
+
+	/* Not loaded with shared_preload_libraries */
+	if (!pending || indexStats == NULL)
+	{
+		MemSet(counts, 0, sizeof(IndexStatsCounts));
+		return;
+	}
+
+	LWLockAcquire(indexStats->lock, LW_SHARED);
+
+	entry = IndexStatsGetEntry(index, &logFull);
+	if (entry != NULL)
+	{
+		for (int i = 0; i < INDEX_STATS_COUNTERS; i++)
+		{
+			if (counts->counts[i] != 0)
+				pg_atomic_fetch_add_u64(&entry->counters[i], counts->counts[i]);
+		}
+	}
+
+	LWLockRelease(indexStats->lock);
+
+	MemSet(counts, 0, sizeof(IndexStatsCounts));
+
+	if (logFull)
+		ereport(LOG,
+				(errmsg("vector index statistics are full, ignoring new indexes"),
+				 errhint("Reset them with pg_stat_vector_indexes_reset().")));
+}
+
+/*
+ * Ensure loaded with shared_preload_libraries
+ */
+static void
+CheckIndexStatsLoaded(void)
+{
+	if (indexStats == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("vector must be loaded via \"shared_preload_libraries\" for index statistics")));
+}
+
+/*
+ * Get the statistics of indexes in the current database
+ */
+FUNCTION_PREFIX PG_FUNCTION_INFO_V1(pg_stat_vector_indexes);
+Datum
+pg_stat_vector_indexes(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldCtx;
+	HASH_SEQ_STATUS status;
+	IndexStatsEntry *entry;
+
+	CheckIndexStatsLoaded();
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) || !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldCtx = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldCtx);
+
+	LWLockAcquire(indexStats->lock, LW_SHARED);
+
+	hash_seq_init(&status, indexStatsHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		Datum		values[INDEX_STATS_COUNTERS + 1];
+		bool		isnull[INDEX_STATS_COUNTERS + 1] = {0};
+
+		if (entry->key.dbid != MyDatabaseId)
+			continue;
+
+		values[0] = ObjectIdGetDatum(entry->key.indexid);
+		for (int i = 0; i < INDEX_STATS_COUNTERS; i++)
+			values[i + 1] = Int64GetDatum((int64) pg_atomic_read_u64(&entry->counters[i]));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, isnull);
+	}
+
+	LWLockRelease(indexStats->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * Reset the statistics of all indexes
+ */
+FUNCTION_PREFIX PG_FUNCTION_INFO_V1(pg_stat_vector_indexes_reset);
+Datum
+pg_stat_vector_indexes_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS status;
+	IndexStatsEntry *entry;
+
+	CheckIndexStatsLoaded();
+
+	LWLockAcquire(indexStats->lock, LW_EXCLUSIVE);
+
+	/* Also removes entries of dropped databases */
+	hash_seq_init(&status, indexStatsHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+		hash_search(indexStatsHash, &entry->key, HASH_REMOVE, NULL);
+
+	indexStats->generation++;
+	indexStats->full = false;
+
+	LWLockRelease(indexStats->lock);
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,37 @@
+#ifndef INDEXSTATS_H
+#define INDEXSTATS_H
+
+#include "postgres.h"
+
+#include "utils/relcache.h"
+
+/* Cumulative counters for each index */
+typedef enum IndexStatsCounter
+{
+	INDEX_STATS_DISTANCES,
+	INDEX_STATS_PAGES_READ,
+	INDEX_STATS_TUPLES_VISITED,
+	INDEX_STATS_RESUMES,
+	INDEX_STATS_CUTOFFS,
+	INDEX_STATS_NEIGHBOR_UPDATES,
+	INDEX_STATS_LOCK_WAITS,
+	INDEX_STATS_COUNTERS
+}			IndexStatsCounter;
+
+/* Counts of a scan or operation that have not been flushed */
+typedef struct IndexStatsCounts
+{
+	int64		counts[INDEX_STATS_COUNTERS];
+}			IndexStatsCounts;
+
+/* Counts of the scan or operation running in this backend */
+extern IndexStatsCounts * IndexStatsCurrent;
+
+#define IndexStatsCount(counter, n) (IndexStatsCurrent->counts[(counter)] += (n))
+
+void		IndexStatsInit(void);
+IndexStatsCounts *IndexStatsBegin(IndexStatsCounts * counts);
+void		IndexStatsEnd(IndexStatsCounts * prev);
+void		IndexStatsFlush(Relation index, IndexStatsCounts * counts);
+
+#endif
@@ -7,6 +7,7 @@
 #include "access/parallel.h"
 #include "access/xact.h"
 #include "bitvec.h"
+#include "bulkwrite.h"
 #include "catalog/index.h"
 #include "catalog/pg_operator_d.h"
 #include "catalog/pg_type_d.h"
@@ -161,7 +162,7 @@ AddTupleToSort(Relation index, ItemPointer tid, Datum *values, IvfflatBuildState
 	/* Find the list that minimizes the distance */
 	for (int i = 0; i < centers->length; i++)
 	{
-		distance = DatumGetFloat8(FunctionCall2Coll(buildstate->procinfo, buildstate->collation, value, PointerGetDatum(VectorArrayGet(centers, i))));
+		distance = IvfflatGetDistance(buildstate->kernel, buildstate->procinfo, buildstate->collation, value, PointerGetDatum(VectorArrayGet(centers, i)));
 
 		if (distance < minDistance)
 		{
@@ -244,11 +245,39 @@ GetNextTuple(Tuplesortstate *sortstate, TupleDesc tupdesc, TupleTableSlot *slot,
 		*list = -1;
 }
 
+/*
+ * Init a page from the bulk writer
+ */
+static void
+IvfflatBulkInitPage(Page page)
+{
+	PageInit(page, BLCKSZ, sizeof(IvfflatPageOpaqueData));
+	IvfflatPageGetOpaque(page)->nextblkno = InvalidBlockNumber;
+	IvfflatPageGetOpaque(page)->page_id = IVFFLAT_PAGE_ID;
+}
+
+/*
+ * Write the current page and add a new one
+ */
+static void
+IvfflatBulkAppendPage(BulkWriter * writer, Page *page, BlockNumber *blkno)
+{
+	/* Update the previous page */
+	IvfflatPageGetOpaque(*page)->nextblkno = *blkno + 1;
+
+	BulkWriterWrite(writer, *blkno, *page);
+
+	/* Init new page */
+	*page = BulkWriterGetPage(writer);
+	IvfflatBulkInitPage(*page);
+	(*blkno)++;
+}
+
 /*
  * Create initial entry pages
  */
 static void
-InsertTuples(Relation index, IvfflatBuildState * buildstate, ForkNumber forkNum)
+InsertTuples(Relation index, IvfflatBuildState * buildstate, BulkWriter * writer, BlockNumber blkno)
 {
 	int			list;
 	IndexTuple	itup = NULL;	/* silence compiler warning */
@@ -265,20 +294,15 @@ InsertTuples(Relation index, IvfflatBuildState * buildstate, ForkNumber forkNum)
 
 	for (int i = 0; i < buildstate->centers->length; i++)
 	{
-		Buffer		buf;
 		Page		page;
-		GenericXLogState *state;
-		BlockNumber startPage;
-		BlockNumber insertPage;
 
 		/* Can take a while, so ensure we can interrupt */
-		/* Needs to be called when no buffer locks are held */
 		CHECK_FOR_INTERRUPTS();
 
-		buf = IvfflatNewBuffer(index, forkNum);
-		IvfflatInitRegisterPage(index, &buf, &page, &state);
+		page = BulkWriterGetPage(writer);
+		IvfflatBulkInitPage(page);
 
-		startPage = BufferGetBlockNumber(buf);
+		buildstate->startPages[i] = blkno;
 
 		/* Get all tuples for list */
 		while (list == i)
@@ -287,7 +311,7 @@ InsertTuples(Relation index, IvfflatBuildState * buildstate, ForkNumber forkNum)
 			Size		itemsz = MAXALIGN(IndexTupleSize(itup));
 
 			if (PageGetFreeSpace(page) < itemsz)
-				IvfflatAppendPage(index, &buf, &page, &state, forkNum);
+				IvfflatBulkAppendPage(writer, &page, &blkno);
 
 			/* Add the item */
 			if (PageAddItem(page, (Item) itup, itemsz, InvalidOffsetNumber, false, false) == InvalidOffsetNumber)
@@ -300,12 +324,10 @@ InsertTuples(Relation index, IvfflatBuildState * buildstate, ForkNumber forkNum)
 			GetNextTuple(buildstate->sortstate, tupdesc, slot, &itup, &list);
 		}
 
-		insertPage = BufferGetBlockNumber(buf);
-
-		IvfflatCommitBuffer(buf, state);
+		buildstate->insertPages[i] = blkno;
 
-		/* Set the start and insert pages */
-		IvfflatUpdateList(index, buildstate->listInfo[i], insertPage, InvalidBlockNumber, startPage, forkNum);
+		BulkWriterWrite(writer, blkno, page);
+		blkno++;
 	}
 }
 
@@ -349,6 +371,7 @@ InitBuildState(IvfflatBuildState * buildstate, Relation heap, Relation index, In
 	buildstate->normprocinfo = IvfflatOptionalProcInfo(index, IVFFLAT_NORM_PROC);
 	buildstate->kmeansnormprocinfo = IvfflatOptionalProcInfo(index, IVFFLAT_KMEANS_NORM_PROC);
 	buildstate->collation = index->rd_indcollation[0];
+	buildstate->kernel = IvfflatGetDistanceKernel(buildstate->typeInfo, buildstate->procinfo);
 
 	/* Require more than one dimension for spherical k-means */
 	if (buildstate->kmeansnormprocinfo != NULL && buildstate->dimensions == 1)
@@ -365,7 +388,8 @@ InitBuildState(IvfflatBuildState * buildstate, Relation heap, Relation index, In
 	buildstate->slot = MakeSingleTupleTableSlot(buildstate->sortdesc, &TTSOpsVirtual);
 
 	buildstate->centers = VectorArrayInit(buildstate->lists, buildstate->dimensions, buildstate->typeInfo->itemSize(buildstate->dimensions));
-	buildstate->listInfo = palloc(sizeof(ListInfo) * buildstate->lists);
+	buildstate->startPages = palloc(sizeof(BlockNumber) * buildstate->lists);
+	buildstate->insertPages = palloc(sizeof(BlockNumber) * buildstate->lists);
 
 	buildstate->tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
 											   "Ivfflat build temporary context",
@@ -387,7 +411,8 @@ static void
 FreeBuildState(IvfflatBuildState * buildstate)
 {
 	VectorArrayFree(buildstate->centers);
-	pfree(buildstate->listInfo);
+	pfree(buildstate->startPages);
+	pfree(buildstate->insertPages);
 
 #ifdef IVFFLAT_KMEANS_DEBUG
 	pfree(buildstate->listSums);
@@ -444,15 +469,13 @@ ComputeCenters(IvfflatBuildState * buildstate)
  * Create the metapage
  */
 static void
-CreateMetaPage(Relation index, int dimensions, int lists, ForkNumber forkNum)
+CreateMetaPage(BulkWriter * writer, int dimensions, int lists)
 {
-	Buffer		buf;
 	Page		page;
-	GenericXLogState *state;
 	IvfflatMetaPage metap;
 
-	buf = IvfflatNewBuffer(index, forkNum);
-	IvfflatInitRegisterPage(index, &buf, &page, &state);
+	page = BulkWriterGetPage(writer);
+	IvfflatBulkInitPage(page);
 
 	/* Set metapage data */
 	metap = IvfflatPageGetMeta(page);
@@ -463,55 +486,66 @@ CreateMetaPage(Relation index, int dimensions, int lists, ForkNumber forkNum)
 	((PageHeader) page)->pd_lower =
 		((char *) metap + sizeof(IvfflatMetaPageData)) - (char *) page;
 
-	IvfflatCommitBuffer(buf, state);
+	BulkWriterWrite(writer, IVFFLAT_METAPAGE_BLKNO, page);
+}
+
+/*
+ * Get the number of list pages
+ */
+static BlockNumber
+GetListPageCount(VectorArray centers, int lists)
+{
+	Size		listSize = MAXALIGN(IVFFLAT_LIST_SIZE(centers->itemsize));
+	Size		pageSize = BLCKSZ - SizeOfPageHeaderData - MAXALIGN(sizeof(IvfflatPageOpaqueData));
+	int			listsPerPage = pageSize / (listSize + sizeof(ItemIdData));
+
+	return (lists + listsPerPage - 1) / listsPerPage;
 }
 
 /*
  * Create list pages
+ *
+ * Written after the entry pages so the start and insert pages are known
  */
 static void
-CreateListPages(Relation index, VectorArray centers, int dimensions,
-				int lists, ForkNumber forkNum, ListInfo * *listInfo)
+CreateListPages(Relation index, BulkWriter * writer, VectorArray centers, int lists,
+				BlockNumber *startPages, BlockNumber *insertPages)
 {
-	Buffer		buf;
 	Page		page;
-	GenericXLogState *state;
 	Size		listSize;
 	IvfflatList list;
+	BlockNumber blkno = IVFFLAT_METAPAGE_BLKNO + 1;
 
 	listSize = MAXALIGN(IVFFLAT_LIST_SIZE(centers->itemsize));
 	list = palloc0(listSize);
 
-	buf = IvfflatNewBuffer(index, forkNum);
-	IvfflatInitRegisterPage(index, &buf, &page, &state);
+	page = BulkWriterGetPage(writer);
+	IvfflatBulkInitPage(page);
 
 	for (int i = 0; i < lists; i++)
 	{
-		OffsetNumber offno;
-
 		/* Zero memory for each list */
 		MemSet(list, 0, listSize);
 
 		/* Load list */
-		list->startPage = InvalidBlockNumber;
-		list->insertPage = InvalidBlockNumber;
+		list->startPage = startPages[i];
+		list->insertPage = insertPages[i];
 		memcpy(&list->center, VectorArrayGet(centers, i), VARSIZE_ANY(VectorArrayGet(centers, i)));
 
 		/* Ensure free space */
 		if (PageGetFreeSpace(page) < listSize)
-			IvfflatAppendPage(index, &buf, &page, &state, forkNum);
+			IvfflatBulkAppendPage(writer, &page, &blkno);
 
 		/* Add the item */
-		offno = PageAddItem(page, (Item) list, listSize, InvalidOffsetNumber, false, false);
-		if (offno == InvalidOffsetNumber)
+		if (PageAddItem(page, (Item) list, listSize, InvalidOffsetNumber, false, false) == InvalidOffsetNumber)
 			elog(ERROR, "failed to add index item to \"%s\"", RelationGetRelationName(index));
-
-		/* Save location info */
-		(*listInfo)[i].blkno = BufferGetBlockNumber(buf);
-		(*listInfo)[i].offno = offno;
 	}
 
-	IvfflatCommitBuffer(buf, state);
+	/* Entry pages follow the list pages */
+	if (blkno != GetListPageCount(centers, lists))
+		elog(ERROR, "unexpected number of list pages in \"%s\"", RelationGetRelationName(index));
+
+	BulkWriterWrite(writer, blkno, page);
 
 	pfree(list);
 }
@@ -972,7 +1006,7 @@ AssignTuples(IvfflatBuildState * buildstate)
  * Create entry pages
  */
 static void
-CreateEntryPages(IvfflatBuildState * buildstate, ForkNumber forkNum)
+CreateEntryPages(IvfflatBuildState * buildstate, BulkWriter * writer, BlockNumber startPage)
 {
 	/* Assign */
 	IvfflatBench("assign tuples", AssignTuples(buildstate));
@@ -981,7 +1015,7 @@ CreateEntryPages(IvfflatBuildState * buildstate, ForkNumber forkNum)
 	IvfflatBench("sort tuples", tuplesort_performsort(buildstate->sortstate));
 
 	/* Load */
-	IvfflatBench("load tuples", InsertTuples(buildstate->index, buildstate, forkNum));
+	IvfflatBench("load tuples", InsertTuples(buildstate->index, buildstate, writer, startPage));
 
 	/* End sort */
 	tuplesort_end(buildstate->sortstate);
@@ -998,18 +1032,18 @@ static void
 BuildIndex(Relation heap, Relation index, IndexInfo *indexInfo,
 		   IvfflatBuildState * buildstate, ForkNumber forkNum)
 {
+	BulkWriter *writer;
+
 	InitBuildState(buildstate, heap, index, indexInfo);
 
 	ComputeCenters(buildstate);
 
-	/* Create pages */
-	CreateMetaPage(index, buildstate->dimensions, buildstate->lists, forkNum);
-	CreateListPages(index, buildstate->centers, buildstate->dimensions, buildstate->lists, forkNum, &buildstate->listInfo);
-	CreateEntryPages(buildstate, forkNum);
-
-	/* Write WAL for initialization fork since GenericXLog functions do not */
-	if (forkNum == INIT_FORKNUM)
-		log_newpage_range(index, forkNum, 0, RelationGetNumberOfBlocksInFork(index, forkNum), true);
+	/* Create pages without going through shared buffers */
+	writer = BulkWriterStart(index, forkNum);
+	CreateMetaPage(writer, buildstate->dimensions, buildstate->lists);
+	CreateEntryPages(buildstate, writer, IVFFLAT_METAPAGE_BLKNO + 1 + GetListPageCount(buildstate->centers, buildstate->lists));
+	CreateListPages(index, writer, buildstate->centers, buildstate->lists, buildstate->startPages, buildstate->insertPages);
+	BulkWriterFinish(writer);
 
 	FreeBuildState(buildstate);
 }
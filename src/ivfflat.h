@@ -11,6 +11,7 @@
 #include "port.h"				/* for random() */
 #include "utils/sampling.h"
 #include "utils/tuplesort.h"
+#include "indexstats.h"
 #include "vector.h"
 
 #if PG_VERSION_NUM >= 150000
@@ -164,6 +165,7 @@ typedef struct IvfflatTypeInfo
 	Size		(*itemSize) (int dimensions);
 	void		(*updateCenter) (Pointer v, int dimensions, float *x);
 	void		(*sumCenter) (Pointer v, float *x);
+	VectorDistanceKernel (*getDistanceKernel) (PGFunction fn);
 }			IvfflatTypeInfo;
 
 typedef struct IvfflatBuildState
@@ -188,11 +190,13 @@ typedef struct IvfflatBuildState
 	FmgrInfo   *normprocinfo;
 	FmgrInfo   *kmeansnormprocinfo;
 	Oid			collation;
+	VectorDistanceKernel kernel;
 
 	/* Variables */
 	VectorArray samples;
 	VectorArray centers;
-	ListInfo   *listInfo;
+	BlockNumber *startPages;
+	BlockNumber *insertPages;
 
 #ifdef IVFFLAT_KMEANS_DEBUG
 	double		inertia;
@@ -257,11 +261,15 @@ typedef struct IvfflatScanOpaqueData
 	const		IvfflatTypeInfo *typeInfo;
 	int			probes;
 	int			maxProbes;
+	bool		maxProbesCutoff;
 	int			dimensions;
 	bool		first;
 	Datum		value;
 	MemoryContext tmpCtx;
 
+	/* Flushed at the end of the scan */
+	IndexStatsCounts counts;
+
 	/* Sorting */
 	Tuplesortstate *sortstate;
 	TupleDesc	tupdesc;
@@ -274,6 +282,7 @@ typedef struct IvfflatScanOpaqueData
 	FmgrInfo   *normprocinfo;
 	Oid			collation;
 	Datum		(*distfunc) (FmgrInfo *flinfo, Oid collation, Datum arg1, Datum arg2);
+	VectorDistanceKernel kernel;
 
 	/* Lists */
 	pairingheap *listQueue;
@@ -288,6 +297,18 @@ typedef IvfflatScanOpaqueData * IvfflatScanOpaque;
 
 /* Use functions instead of macros to avoid double evaluation */
 
+/*
+ * Get the distance between values, skipping fmgr when there is a kernel
+ */
+static inline double
+IvfflatGetDistance(VectorDistanceKernel kernel, FmgrInfo *procinfo, Oid collation, Datum a, Datum b)
+{
+	if (kernel != NULL)
+		return kernel(a, b);
+
+	return DatumGetFloat8(FunctionCall2Coll(procinfo, collation, a, b));
+}
+
 static inline Pointer
 VectorArrayGet(VectorArray arr, int offset)
 {
@@ -307,14 +328,13 @@ void		IvfflatKmeans(Relation index, VectorArray samples, VectorArray centers, co
 FmgrInfo   *IvfflatOptionalProcInfo(Relation index, uint16 procnum);
 Datum		IvfflatNormValue(const IvfflatTypeInfo * typeInfo, Oid collation, Datum value);
 bool		IvfflatCheckNorm(FmgrInfo *procinfo, Oid collation, Datum value);
+VectorDistanceKernel IvfflatGetDistanceKernel(const IvfflatTypeInfo * typeInfo, FmgrInfo *procinfo);
 int			IvfflatGetLists(Relation index);
 void		IvfflatGetMetaPageInfo(Relation index, int *lists, int *dimensions);
 void		IvfflatUpdateList(Relation index, ListInfo listInfo, BlockNumber insertPage, BlockNumber originalInsertPage, BlockNumber startPage, ForkNumber forkNum);
 void		IvfflatCommitBuffer(Buffer buf, GenericXLogState *state);
-void		IvfflatAppendPage(Relation index, Buffer *buf, Page *page, GenericXLogState **state, ForkNumber forkNum);
 Buffer		IvfflatNewBuffer(Relation index, ForkNumber forkNum);
 void		IvfflatInitPage(Buffer buf, Page page);
-void		IvfflatInitRegisterPage(Relation index, Buffer *buf, Page *page, GenericXLogState **state);
 void		IvfflatInit(void);
 const		IvfflatTypeInfo *IvfflatGetTypeInfo(Relation index);
 PGDLLEXPORT void IvfflatParallelBuildMain(dsm_segment *seg, shm_toc *toc);
@@ -18,6 +18,7 @@ FindInsertPage(Relation index, Datum *values, BlockNumber *insertPage, ListInfo
 	BlockNumber nextblkno = IVFFLAT_HEAD_BLKNO;
 	FmgrInfo   *procinfo;
 	Oid			collation;
+	VectorDistanceKernel kernel;
 
 	/* Avoid compiler warning */
 	listInfo->blkno = nextblkno;
@@ -25,6 +26,7 @@ FindInsertPage(Relation index, Datum *values, BlockNumber *insertPage, ListInfo
 
 	procinfo = index_getprocinfo(index, 1, IVFFLAT_DISTANCE_PROC);
 	collation = index->rd_indcollation[0];
+	kernel = IvfflatGetDistanceKernel(IvfflatGetTypeInfo(index), procinfo);
 
 	/* Search all list pages */
 	while (BlockNumberIsValid(nextblkno))
@@ -44,7 +46,7 @@ FindInsertPage(Relation index, Datum *values, BlockNumber *insertPage, ListInfo
 			double		distance;
 
 			list = (IvfflatList) PageGetItem(cpage, PageGetItemId(cpage, offno));
-			distance = DatumGetFloat8(FunctionCall2Coll(procinfo, collation, values[0], PointerGetDatum(&list->center)));
+			distance = IvfflatGetDistance(kernel, procinfo, collation, values[0], PointerGetDatum(&list->center));
 
 			if (distance < minDistance || !BlockNumberIsValid(*insertPage))
 			{
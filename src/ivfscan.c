@@ -30,6 +30,20 @@ CompareLists(const pairingheap_node *a, const pairingheap_node *b, void *arg)
 	return 0;
 }
 
+/*
+ * Get the distance for a scan
+ */
+static inline double
+GetScanDistance(IvfflatScanOpaque so, Datum a, Datum b)
+{
+	IndexStatsCount(INDEX_STATS_DISTANCES, 1);
+
+	if (so->kernel != NULL)
+		return so->kernel(a, b);
+
+	return DatumGetFloat8(so->distfunc(so->procinfo, so->collation, a, b));
+}
+
 /*
  * Get lists and sort by distance
  */
@@ -50,6 +64,7 @@ GetScanLists(IndexScanDesc scan, Datum value)
 
 		cbuf = ReadBuffer(scan->indexRelation, nextblkno);
 		LockBuffer(cbuf, BUFFER_LOCK_SHARE);
+		IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
 		cpage = BufferGetPage(cbuf);
 
 		maxoffno = PageGetMaxOffsetNumber(cpage);
@@ -60,7 +75,7 @@ GetScanLists(IndexScanDesc scan, Datum value)
 			double		distance;
 
 			/* Use procinfo from the index instead of scan key for performance */
-			distance = DatumGetFloat8(so->distfunc(so->procinfo, so->collation, PointerGetDatum(&list->center), value));
+			distance = GetScanDistance(so, PointerGetDatum(&list->center), value);
 
 			if (listCount < so->maxProbes)
 			{
@@ -133,8 +148,10 @@ GetScanItems(IndexScanDesc scan, Datum value)
 
 			buf = ReadBufferExtended(scan->indexRelation, MAIN_FORKNUM, searchPage, RBM_NORMAL, so->bas);
 			LockBuffer(buf, BUFFER_LOCK_SHARE);
+			IndexStatsCount(INDEX_STATS_PAGES_READ, 1);
 			page = BufferGetPage(buf);
 			maxoffno = PageGetMaxOffsetNumber(page);
+			IndexStatsCount(INDEX_STATS_TUPLES_VISITED, maxoffno);
 
 			for (OffsetNumber offno = FirstOffsetNumber; offno <= maxoffno; offno = OffsetNumberNext(offno))
 			{
@@ -153,7 +170,7 @@ GetScanItems(IndexScanDesc scan, Datum value)
 				 * performance
 				 */
 				ExecClearTuple(slot);
-				slot->tts_values[0] = so->distfunc(so->procinfo, so->collation, datum, value);
+				slot->tts_values[0] = Float8GetDatum(GetScanDistance(so, datum, value));
 				slot->tts_isnull[0] = false;
 				slot->tts_values[1] = PointerGetDatum(&itup->t_tid);
 				slot->tts_isnull[1] = false;
@@ -197,11 +214,13 @@ GetScanValue(IndexScanDesc scan)
 	{
 		value = PointerGetDatum(NULL);
 		so->distfunc = ZeroDistance;
+		so->kernel = NULL;
 	}
 	else
 	{
 		value = scan->orderByData->sk_argument;
 		so->distfunc = FunctionCall2Coll;
+		so->kernel = IvfflatGetDistanceKernel(so->typeInfo, so->procinfo);
 
 		/* Value should not be compressed or toasted */
 		Assert(!VARATT_IS_COMPRESSED(DatumGetPointer(value)));
@@ -270,12 +289,14 @@ ivfflatbeginscan(Relation index, int nkeys, int norderbys)
 	so->first = true;
 	so->probes = probes;
 	so->maxProbes = maxProbes;
+	so->maxProbesCutoff = maxProbes < lists && ivfflat_iterative_scan != IVFFLAT_ITERATIVE_SCAN_OFF;
 	so->dimensions = dimensions;
 
 	/* Set support functions */
 	so->procinfo = index_getprocinfo(index, 1, IVFFLAT_DISTANCE_PROC);
 	so->normprocinfo = IvfflatOptionalProcInfo(index, IVFFLAT_NORM_PROC);
 	so->collation = index->rd_indcollation[0];
+	MemSet(&so->counts, 0, sizeof(IndexStatsCounts));
 
 	so->tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
 									   "Ivfflat scan temporary context",
@@ -342,6 +363,7 @@ ivfflatgettuple(IndexScanDesc scan, ScanDirection dir)
 	IvfflatScanOpaque so = (IvfflatScanOpaque) scan->opaque;
 	ItemPointer heaptid;
 	bool		isnull;
+	IndexStatsCounts *prevCounts = IndexStatsBegin(&so->counts);
 
 	/*
 	 * Index can be used to scan backward, but Postgres doesn't support
@@ -375,8 +397,15 @@ ivfflatgettuple(IndexScanDesc scan, ScanDirection dir)
 	while (!tuplesort_gettupleslot(so->sortstate, true, false, so->mslot, NULL))
 	{
 		if (so->listIndex == so->maxProbes)
+		{
+			if (so->maxProbesCutoff)
+				IndexStatsCount(INDEX_STATS_CUTOFFS, 1);
+
+			IndexStatsEnd(prevCounts);
 			return false;
+		}
 
+		IndexStatsCount(INDEX_STATS_RESUMES, 1);
 		IvfflatBench("GetScanItems", GetScanItems(scan, so->value));
 	}
 
@@ -385,6 +414,8 @@ ivfflatgettuple(IndexScanDesc scan, ScanDirection dir)
 	scan->xs_heaptid = *heaptid;
 	scan->xs_recheck = false;
 	scan->xs_recheckorderby = false;
+
+	IndexStatsEnd(prevCounts);
 	return true;
 }
 
@@ -396,6 +427,8 @@ ivfflatendscan(IndexScanDesc scan)
 {
 	IvfflatScanOpaque so = (IvfflatScanOpaque) scan->opaque;
 
+	IndexStatsFlush(scan->indexRelation, &so->counts);
+
 	/* Free any temporary files */
 	tuplesort_end(so->sortstate);
 
@@ -82,6 +82,18 @@ IvfflatCheckNorm(FmgrInfo *procinfo, Oid collation, Datum value)
 	return DatumGetFloat8(FunctionCall1Coll(procinfo, collation, value)) > 0;
 }
 
+/*
+ * Get the kernel for built-in distance functions
+ */
+VectorDistanceKernel
+IvfflatGetDistanceKernel(const IvfflatTypeInfo * typeInfo, FmgrInfo *procinfo)
+{
+	if (typeInfo->getDistanceKernel == NULL)
+		return NULL;
+
+	return typeInfo->getDistanceKernel(procinfo->fn_addr);
+}
+
 /*
  * New buffer
  */
@@ -105,17 +117,6 @@ IvfflatInitPage(Buffer buf, Page page)
 	IvfflatPageGetOpaque(page)->page_id = IVFFLAT_PAGE_ID;
 }
 
-/*
- * Init and register page
- */
-void
-IvfflatInitRegisterPage(Relation index, Buffer *buf, Page *page, GenericXLogState **state)
-{
-	*state = GenericXLogStart(index);
-	*page = GenericXLogRegisterBuffer(*state, *buf, GENERIC_XLOG_FULL_IMAGE);
-	IvfflatInitPage(*buf, *page);
-}
-
 /*
  * Commit buffer
  */
@@ -126,35 +127,6 @@ IvfflatCommitBuffer(Buffer buf, GenericXLogState *state)
 	UnlockReleaseBuffer(buf);
 }
 
-/*
- * Add a new page
- *
- * The order is very important!!
- */
-void
-IvfflatAppendPage(Relation index, Buffer *buf, Page *page, GenericXLogState **state, ForkNumber forkNum)
-{
-	/* Get new buffer */
-	Buffer		newbuf = IvfflatNewBuffer(index, forkNum);
-	Page		newpage = GenericXLogRegisterBuffer(*state, newbuf, GENERIC_XLOG_FULL_IMAGE);
-
-	/* Update the previous buffer */
-	IvfflatPageGetOpaque(*page)->nextblkno = BufferGetBlockNumber(newbuf);
-
-	/* Init new page */
-	IvfflatInitPage(newbuf, newpage);
-
-	/* Commit */
-	GenericXLogFinish(*state);
-
-	/* Unlock */
-	UnlockReleaseBuffer(*buf);
-
-	*state = GenericXLogStart(index);
-	*page = GenericXLogRegisterBuffer(*state, newbuf, GENERIC_XLOG_FULL_IMAGE);
-	*buf = newbuf;
-}
-
 /*
  * Get the metapage info
  */
@@ -333,7 +305,8 @@ IvfflatGetTypeInfo(Relation index)
 			.normalize = l2_normalize,
 			.itemSize = VectorItemSize,
 			.updateCenter = VectorUpdateCenter,
-			.sumCenter = VectorSumCenter
+			.sumCenter = VectorSumCenter,
+			.getDistanceKernel = VectorGetDistanceKernel
 		};
 
 		return (&typeInfo);
@@ -351,7 +324,8 @@ ivfflat_halfvec_support(PG_FUNCTION_ARGS)
 		.normalize = halfvec_l2_normalize,
 		.itemSize = HalfvecItemSize,
 		.updateCenter = HalfvecUpdateCenter,
-		.sumCenter = HalfvecSumCenter
+		.sumCenter = HalfvecSumCenter,
+		.getDistanceKernel = HalfvecGetDistanceKernel
 	};
 
 	PG_RETURN_POINTER(&typeInfo);
@@ -366,7 +340,8 @@ ivfflat_bit_support(PG_FUNCTION_ARGS)
 		.normalize = NULL,
 		.itemSize = BitItemSize,
 		.updateCenter = BitUpdateCenter,
-		.sumCenter = BitSumCenter
+		.sumCenter = BitSumCenter,
+		.getDistanceKernel = BitGetDistanceKernel
 	};
 
 	PG_RETURN_POINTER(&typeInfo);
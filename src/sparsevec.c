@@ -1036,6 +1036,49 @@ sparsevec_l1_distance(PG_FUNCTION_ARGS)
 	PG_RETURN_FLOAT8((double) distance);
 }
 
+/*
+ * Get the L2 squared distance between sparse vectors without fmgr
+ */
+static double
+SparsevecL2SquaredDistanceKernel(Datum ad, Datum bd)
+{
+	SparseVector *a = DatumGetSparseVector(ad);
+	SparseVector *b = DatumGetSparseVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) SparsevecL2SquaredDistance(a, b);
+}
+
+/*
+ * Get the negative inner product of two sparse vectors without fmgr
+ */
+static double
+SparsevecNegativeInnerProductKernel(Datum ad, Datum bd)
+{
+	SparseVector *a = DatumGetSparseVector(ad);
+	SparseVector *b = DatumGetSparseVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) -SparsevecInnerProduct(a, b);
+}
+
+/*
+ * Get the kernel for a distance function, or NULL if none
+ */
+VectorDistanceKernel
+SparsevecGetDistanceKernel(PGFunction fn)
+{
+	if (fn == sparsevec_l2_squared_distance)
+		return SparsevecL2SquaredDistanceKernel;
+
+	if (fn == sparsevec_negative_inner_product)
+		return SparsevecNegativeInnerProductKernel;
+
+	return NULL;
+}
+
 /*
  * Get the L2 norm of a sparse vector
  */
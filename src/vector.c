@@ -10,6 +10,7 @@
 #include "halfutils.h"
 #include "halfvec.h"
 #include "hnsw.h"
+#include "indexstats.h"
 #include "ivfflat.h"
 #include "lib/stringinfo.h"
 #include "libpq/pqformat.h"
@@ -48,6 +49,7 @@ _PG_init(void)
 	HalfvecInit();
 	HnswInit();
 	IvfflatInit();
+	IndexStatsInit();
 }
 
 /*
@@ -734,6 +736,229 @@ l1_distance(PG_FUNCTION_ARGS)
 	PG_RETURN_FLOAT8((double) VectorL1Distance(a->dim, a->x, b->x));
 }
 
+/*
+ * Get the L2 squared distance between vectors without fmgr
+ */
+static double
+VectorL2SquaredDistanceKernel(Datum ad, Datum bd)
+{
+	Vector	   *a = DatumGetVector(ad);
+	Vector	   *b = DatumGetVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) VectorL2SquaredDistance(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the negative inner product of two vectors without fmgr
+ */
+static double
+VectorNegativeInnerProductKernel(Datum ad, Datum bd)
+{
+	Vector	   *a = DatumGetVector(ad);
+	Vector	   *b = DatumGetVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) -VectorInnerProduct(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the L1 distance between two vectors without fmgr
+ */
+static double
+VectorL1DistanceKernel(Datum ad, Datum bd)
+{
+	Vector	   *a = DatumGetVector(ad);
+	Vector	   *b = DatumGetVector(bd);
+
+	CheckDims(a, b);
+
+	return (double) VectorL1Distance(a->dim, a->x, b->x);
+}
+
+/*
+ * Get the kernel for a distance function, or NULL if none
+ */
+VectorDistanceKernel
+VectorGetDistanceKernel(PGFunction fn)
+{
+	if (fn == vector_l2_squared_distance)
+		return VectorL2SquaredDistanceKernel;
+
+	if (fn == vector_negative_inner_product)
+		return VectorNegativeInnerProductKernel;
+
+	if (fn == l1_distance)
+		return VectorL1DistanceKernel;
+
+	return NULL;
+}
+
+/* Compares one vector to four vectors, loading each element of the first once */
+typedef void (*VectorDistance4) (int dim, float *ax, float **bx, float *distances);
+
+VECTOR_TARGET_CLONES static void
+VectorL2SquaredDistance4(int dim, float *ax, float **bx, float *distances)
+{
+	float	   *b0 = bx[0];
+	float	   *b1 = bx[1];
+	float	   *b2 = bx[2];
+	float	   *b3 = bx[3];
+	float		d0 = 0.0;
+	float		d1 = 0.0;
+	float		d2 = 0.0;
+	float		d3 = 0.0;
+
+	/* Auto-vectorized */
+	for (int i = 0; i < dim; i++)
+	{
+		float		a = ax[i];
+		float		diff0 = a - b0[i];
+		float		diff1 = a - b1[i];
+		float		diff2 = a - b2[i];
+		float		diff3 = a - b3[i];
+
+		d0 += diff0 * diff0;
+		d1 += diff1 * diff1;
+		d2 += diff2 * diff2;
+		d3 += diff3 * diff3;
+	}
+
+	distances[0] = d0;
+	distances[1] = d1;
+	distances[2] = d2;
+	distances[3] = d3;
+}
+
+VECTOR_TARGET_CLONES static void
+VectorNegativeInnerProduct4(int dim, float *ax, float **bx, float *distances)
+{
+	float	   *b0 = bx[0];
+	float	   *b1 = bx[1];
+	float	   *b2 = bx[2];
+	float	   *b3 = bx[3];
+	float		d0 = 0.0;
+	float		d1 = 0.0;
+	float		d2 = 0.0;
+	float		d3 = 0.0;
+
+	/* Auto-vectorized */
+	for (int i = 0; i < dim; i++)
+	{
+		float		a = ax[i];
+
+		d0 += a * b0[i];
+		d1 += a * b1[i];
+		d2 += a * b2[i];
+		d3 += a * b3[i];
+	}
+
+	distances[0] = -d0;
+	distances[1] = -d1;
+	distances[2] = -d2;
+	distances[3] = -d3;
+}
+
+/* Does not require FMA, but keep logic simple */
+VECTOR_TARGET_CLONES static void
+VectorL1Distance4(int dim, float *ax, float **bx, float *distances)
+{
+	float	   *b0 = bx[0];
+	float	   *b1 = bx[1];
+	float	   *b2 = bx[2];
+	float	   *b3 = bx[3];
+	float		d0 = 0.0;
+	float		d1 = 0.0;
+	float		d2 = 0.0;
+	float		d3 = 0.0;
+
+	/* Auto-vectorized */
+	for (int i = 0; i < dim; i++)
+	{
+		float		a = ax[i];
+
+		d0 += fabsf(a - b0[i]);
+		d1 += fabsf(a - b1[i]);
+		d2 += fabsf(a - b2[i]);
+		d3 += fabsf(a - b3[i]);
+	}
+
+	distances[0] = d0;
+	distances[1] = d1;
+	distances[2] = d2;
+	distances[3] = d3;
+}
+
+/*
+ * Get the distances from a vector to many vectors, four at a time
+ */
+static inline void
+VectorDistanceBatch(Datum ad, Datum *bd, int n, double *distances, VectorDistance4 distance4, VectorDistanceKernel kernel)
+{
+	Vector	   *a = DatumGetVector(ad);
+	int			i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		float	   *bx[4];
+		float		d[4];
+
+		for (int j = 0; j < 4; j++)
+		{
+			Vector	   *b = DatumGetVector(bd[i + j]);
+
+			CheckDims(a, b);
+			bx[j] = b->x;
+		}
+
+		distance4(a->dim, a->x, bx, d);
+
+		for (int j = 0; j < 4; j++)
+			distances[i + j] = (double) d[j];
+	}
+
+	for (; i < n; i++)
+		distances[i] = kernel(ad, bd[i]);
+}
+
+static void
+VectorL2SquaredDistanceBatchKernel(Datum ad, Datum *bd, int n, double *distances)
+{
+	VectorDistanceBatch(ad, bd, n, distances, VectorL2SquaredDistance4, VectorL2SquaredDistanceKernel);
+}
+
+static void
+VectorNegativeInnerProductBatchKernel(Datum ad, Datum *bd, int n, double *distances)
+{
+	VectorDistanceBatch(ad, bd, n, distances, VectorNegativeInnerProduct4, VectorNegativeInnerProductKernel);
+}
+
+static void
+VectorL1DistanceBatchKernel(Datum ad, Datum *bd, int n, double *distances)
+{
+	VectorDistanceBatch(ad, bd, n, distances, VectorL1Distance4, VectorL1DistanceKernel);
+}
+
+/*
+ * Get the batch kernel for a distance function, or NULL if none
+ */
+VectorDistanceBatchKernel
+VectorGetDistanceBatchKernel(PGFunction fn)
+{
+	if (fn == vector_l2_squared_distance)
+		return VectorL2SquaredDistanceBatchKernel;
+
+	if (fn == vector_negative_inner_product)
+		return VectorNegativeInnerProductBatchKernel;
+
+	if (fn == l1_distance)
+		return VectorL1DistanceBatchKernel;
+
+	return NULL;
+}
+
 /*
  * Get the dimensions of a vector
  */
@@ -1,6 +1,8 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "fmgr.h"
+
 #define VECTOR_MAX_DIM 16000
 
 #define VECTOR_SIZE(_dim)		(offsetof(Vector, x) + sizeof(float)*(_dim))
@@ -16,10 +18,23 @@ typedef struct Vector
 	float		x[FLEXIBLE_ARRAY_MEMBER];
 }			Vector;
 
+/* Distance function for index hot paths that skips fmgr */
+typedef double (*VectorDistanceKernel) (Datum a, Datum b);
+
+/* Distances from one value to many values in a single call */
+typedef void (*VectorDistanceBatchKernel) (Datum a, Datum *b, int n, double *distances);
+
 Vector	   *InitVector(int dim);
 void		PrintVector(char *msg, Vector * vector);
 int			vector_cmp_internal(Vector * a, Vector * b);
 
+/* Defined with each type */
+VectorDistanceKernel VectorGetDistanceKernel(PGFunction fn);
+VectorDistanceBatchKernel VectorGetDistanceBatchKernel(PGFunction fn);
+VectorDistanceKernel HalfvecGetDistanceKernel(PGFunction fn);
+VectorDistanceKernel SparsevecGetDistanceKernel(PGFunction fn);
+VectorDistanceKernel BitGetDistanceKernel(PGFunction fn);
+
 /* TODO Move to better place */
 #if PG_VERSION_NUM >= 160000
 #define FUNCTION_PREFIX
@@ -84,6 +84,111 @@ SELECT * FROM t ORDER BY val <-> '[3,3,3]';
 
 DROP TABLE t;
 
+-- sq8
+
+CREATE TABLE t (val vector(3));
+INSERT INTO t (val) VALUES ('[0,0,0]'), ('[1,2,3]'), ('[1,1,1]'), (NULL);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (quantization = 'sq8');
+
+INSERT INTO t (val) VALUES ('[1,2,4]');
+
+SELECT * FROM t ORDER BY val <-> '[3,3,3]';
+
+DROP TABLE t;
+
+-- filter columns
+
+CREATE TABLE t (val vector(3), category_id int4);
+INSERT INTO t (val, category_id) VALUES ('[0,0,0]', 1), ('[1,2,3]', 2), ('[1,1,1]', 1), (NULL, 1), ('[1,1,2]', NULL);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops, category_id);
+
+INSERT INTO t (val, category_id) VALUES ('[1,2,4]', 1);
+
+SELECT val FROM t WHERE category_id = 1 ORDER BY val <-> '[3,3,3]';
+SELECT val FROM t WHERE category_id > 1 ORDER BY val <-> '[3,3,3]';
+
+CREATE INDEX ON t USING hnsw (category_id);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops, val vector_l1_ops);
+
+DROP TABLE t;
+
+-- radius
+
+CREATE TABLE t (val vector(3));
+INSERT INTO t (val) VALUES ('[0,0,0]'), ('[1,2,3]'), ('[1,1,1]'), (NULL), ('[1,2,4]');
+CREATE INDEX ON t USING hnsw (val vector_l2_ops);
+
+SELECT * FROM t WHERE val <-> '[3,3,3]' < 3 ORDER BY val <-> '[3,3,3]';
+SELECT * FROM t WHERE 3 >= val <-> '[3,3,3]' ORDER BY val <-> '[3,3,3]';
+SELECT * FROM t ORDER BY val <-> '[3,3,3]';
+
+SET hnsw.iterative_scan = relaxed_order;
+SET hnsw.ef_search = 1;
+SELECT COUNT(*) FROM (SELECT * FROM t WHERE val <-> '[3,3,3]' < 3 ORDER BY val <-> '[3,3,3]') t2;
+RESET hnsw.iterative_scan;
+RESET hnsw.ef_search;
+
+SELECT * FROM t WHERE val <-> '[3,3,3]' < -1 ORDER BY val <-> '[3,3,3]';
+
+SELECT * FROM t WHERE val <-> '[0,0,0]' <= 1.7320508075688772 ORDER BY val <-> '[0,0,0]';
+
+PREPARE radius_stmt (float8) AS SELECT * FROM t WHERE val <-> '[3,3,3]' < $1 ORDER BY val <-> '[3,3,3]';
+EXECUTE radius_stmt(3);
+DEALLOCATE radius_stmt;
+
+DROP INDEX t_val_idx;
+CREATE INDEX ON t USING hnsw (val vector_ip_ops);
+
+SELECT * FROM t WHERE val <#> '[1,1,1]' < -4 ORDER BY val <#> '[1,1,1]';
+
+DROP INDEX t_val_idx;
+CREATE INDEX ON t USING hnsw (val vector_cosine_ops);
+
+SELECT * FROM t WHERE val <=> '[1,1,1]' < 0.1 ORDER BY val <=> '[1,1,1]';
+
+INSERT INTO t (val) VALUES ('[1,0,0]');
+SELECT * FROM t WHERE val <=> '[1,1,0]' <= 0.29289321881345254 ORDER BY val <=> '[1,1,0]';
+
+DROP TABLE t;
+
+-- batch search
+
+CREATE TABLE t (id int4, val vector(3));
+INSERT INTO t (id, val) VALUES (1, '[0,0,0]'), (2, '[1,2,3]'), (3, '[1,1,1]'), (4, NULL);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops);
+
+SELECT r.query_idx, t.id, round(r.distance::numeric, 3) AS distance FROM hnsw_search_batch('t_val_idx', ARRAY['[3,3,3]', '[0,0,0]']::vector[], 2) r JOIN t ON t.ctid = r.tid ORDER BY r.query_idx, r.distance;
+SELECT q.i, t.id FROM (VALUES (1, '[1,1,1]'::vector), (2, '[1,2,4]'::vector)) q (i, v), LATERAL hnsw_search_batch('t_val_idx', ARRAY[q.v], 1) r JOIN t ON t.ctid = r.tid ORDER BY q.i;
+SELECT COUNT(*) FROM hnsw_search_batch('t_val_idx', ARRAY['[3,3,3]']::vector[], 3, 1);
+SELECT COUNT(*) FROM hnsw_search_batch('t_val_idx', NULL::vector[], 1);
+
+DELETE FROM t WHERE id = 2;
+SELECT t.id FROM hnsw_search_batch('t_val_idx', ARRAY['[3,3,3]']::vector[], 2) r JOIN t ON t.ctid = r.tid ORDER BY r.distance;
+
+SELECT * FROM hnsw_search_batch('t_val_idx', ARRAY['[1,1,1]']::vector[], 0);
+SELECT * FROM hnsw_search_batch('t_val_idx', ARRAY['[1,1,1]']::vector[], 1001);
+SELECT * FROM hnsw_search_batch('t_val_idx', ARRAY['[1,1,1]']::vector[], 1, 1001);
+SELECT * FROM hnsw_search_batch('t_val_idx', ARRAY['[1,1,1]']::halfvec[], 1);
+SELECT * FROM hnsw_search_batch('t', ARRAY['[1,1,1]']::vector[], 1);
+
+DROP TABLE t;
+
+-- search trace
+
+CREATE TABLE t (val vector(3));
+INSERT INTO t (val) VALUES ('[0,0,0]'), ('[1,2,3]'), ('[1,1,1]'), (NULL);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops);
+
+SELECT round(distance::numeric, 3) AS distance FROM hnsw_search_trace('t_val_idx', '[1,1,1]'::vector) WHERE layer = 0 ORDER BY distance;
+SELECT SUM(neighbors_scored) FROM hnsw_search_trace('t_val_idx', '[1,1,1]'::vector) WHERE layer = 0;
+SELECT COUNT(*) FROM hnsw_search_trace('t_val_idx', NULL::vector);
+
+SELECT * FROM hnsw_search_trace('t_val_idx', '[1,1,1]'::vector, 1001);
+SELECT * FROM hnsw_search_trace('t_val_idx', '[1,1,1]'::halfvec);
+SELECT * FROM hnsw_search_trace('t', '[1,1,1]'::vector);
+
+DROP TABLE t;
+
 -- options
 
 CREATE TABLE t (val vector(3));
@@ -92,6 +197,7 @@ CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (m = 101);
 CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (ef_construction = 3);
 CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (ef_construction = 1001);
 CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (m = 16, ef_construction = 31);
+CREATE INDEX ON t USING hnsw (val vector_l2_ops) WITH (quantization = 'pq');
 
 SHOW hnsw.ef_search;
 
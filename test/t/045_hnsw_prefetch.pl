@@ -0,0 +1,78 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 64;
+my $array_sql = join(",", ('random()') x $dim);
+my @queries = ();
+my $limit = 20;
+
+# This only checks correctness. Prefetching is a hint to the OS and does not
+# change which buffers are read, so there is no deterministic signal for it,
+# and timings are not checked since the OS page cache is not dropped.
+
+# Initialize node with a graph that does not fit into shared buffers
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_buffers = 1MB));
+$node->start;
+
+# Create table and index
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 20000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+
+my $pages = $node->safe_psql("postgres", "SELECT pg_relation_size('idx') / current_setting('block_size')::int;");
+cmp_ok($pages, '>', 128);
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+sub run_queries
+{
+	my ($depth) = @_;
+	my @results = ();
+
+	# Start each run with cold shared buffers so prefetches are issued
+	$node->restart;
+
+	for my $query (@queries)
+	{
+		push(@results, $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SET hnsw.prefetch_depth = $depth;
+			SELECT i FROM tst ORDER BY v <-> '$query' LIMIT $limit;
+		)));
+	}
+
+	return @results;
+}
+
+my @expected = run_queries(0);
+
+foreach ((1, 8, 64))
+{
+	my $depth = $_;
+	my @actual = run_queries($depth);
+
+	# Prefetching must not change results
+	is_deeply(\@actual, \@expected, "prefetch_depth = $depth");
+}
+
+my $explain = $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET hnsw.prefetch_depth = 16;
+	EXPLAIN ANALYZE SELECT i FROM tst ORDER BY v <-> '$queries[0]' LIMIT $limit;
+));
+like($explain, qr/Index Scan using idx/);
+
+done_testing();
@@ -0,0 +1,174 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node;
+my @queries = ();
+my @expected;
+my $limit = 20;
+my $dim = 64;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub test_recall
+{
+	my ($min, $operator) = @_;
+	my $correct = 0;
+	my $total = 0;
+
+	my $explain = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		EXPLAIN ANALYZE SELECT i FROM tst ORDER BY v $operator '$queries[0]' LIMIT $limit;
+	));
+	like($explain, qr/Index Scan/);
+
+	for my $i (0 .. $#queries)
+	{
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SET hnsw.ef_search = 100;
+			SELECT i FROM tst ORDER BY v $operator '$queries[$i]' LIMIT $limit;
+		));
+		my @actual_ids = split("\n", $actual);
+		my %actual_set = map { $_ => 1 } @actual_ids;
+
+		my @expected_ids = split("\n", $expected[$i]);
+
+		foreach (@expected_ids)
+		{
+			if (exists($actual_set{$_}))
+			{
+				$correct++;
+			}
+			$total++;
+		}
+	}
+
+	cmp_ok($correct / $total, ">=", $min, $operator);
+}
+
+sub test_order
+{
+	my ($operator) = @_;
+
+	# Rows must be in order of exact distances
+	my $actual = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SELECT v $operator '$queries[0]' FROM tst ORDER BY v $operator '$queries[0]' LIMIT 100;
+	));
+	my @distances = split("\n", $actual);
+	my @sorted = sort { $a <=> $b } @distances;
+	is_deeply(\@distances, \@sorted, "$operator order");
+}
+
+# Initialize node
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+# Check index size
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+my $size = $node->safe_psql("postgres", "SELECT pg_relation_size('idx');");
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) WITH (quantization = 'sq8');");
+my $sq8_size = $node->safe_psql("postgres", "SELECT pg_relation_size('idx');");
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+cmp_ok($sq8_size, "<", $size * 0.75);
+
+# Check each index type
+my @operators = ("<->", "<#>", "<=>", "<+>");
+my @opclasses = ("vector_l2_ops", "vector_ip_ops", "vector_cosine_ops", "vector_l1_ops");
+
+for my $i (0 .. $#operators)
+{
+	my $operator = $operators[$i];
+	my $opclass = $opclasses[$i];
+
+	# Get exact results
+	@expected = ();
+	foreach (@queries)
+	{
+		my $res = $node->safe_psql("postgres", "SELECT i FROM tst ORDER BY v $operator '$_' LIMIT $limit;");
+		push(@expected, $res);
+	}
+
+	# Build index
+	$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v $opclass) WITH (quantization = 'sq8');");
+
+	# Test approximate results
+	my $min = $operator eq "<#>" ? 0.85 : 0.9;
+	test_recall($min, $operator);
+	test_order($operator);
+
+	# Check iterative scans
+	my $count = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET hnsw.iterative_scan = strict_order;
+		SET hnsw.ef_search = 10;
+		SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v $operator '$queries[0]' LIMIT 50) t;
+	));
+	is($count, 50, "$operator iterative");
+
+	$node->safe_psql("postgres", "DROP INDEX idx;");
+}
+
+# Check inserts
+$node->safe_psql("postgres", "TRUNCATE tst;");
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) WITH (quantization = 'sq8');");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 2000) i;"
+);
+
+@expected = ();
+foreach (@queries)
+{
+	my $res = $node->safe_psql("postgres", qq(
+		SET enable_indexscan = off;
+		SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;
+	));
+	push(@expected, $res);
+}
+
+test_recall(0.9, "<->");
+
+# Check vacuum
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i % 2 = 0;");
+$node->safe_psql("postgres", "VACUUM tst;");
+
+@expected = ();
+foreach (@queries)
+{
+	my $res = $node->safe_psql("postgres", qq(
+		SET enable_indexscan = off;
+		SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;
+	));
+	push(@expected, $res);
+}
+
+test_recall(0.9, "<->");
+
+# Check type
+$node->safe_psql("postgres", "CREATE TABLE tst2 (v halfvec(3));");
+my ($ret, $stdout, $stderr) = $node->psql("postgres",
+	"CREATE INDEX ON tst2 USING hnsw (v halfvec_l2_ops) WITH (quantization = 'sq8');"
+);
+like($stderr, qr/sq8 quantization is only supported for vector type/);
+
+done_testing();
@@ -0,0 +1,133 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node;
+my @queries = ();
+my @expected;
+my $dim = 3;
+my $nc = 100;
+my $limit = 10;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub filter_sql
+{
+	my ($filter, $c) = @_;
+	$filter =~ s/CVAL/$c/g;
+	return $filter;
+}
+
+sub test_recall
+{
+	my ($min, $filter) = @_;
+	my $correct = 0;
+	my $total = 0;
+	my $rows = 0;
+
+	my $where = filter_sql($filter, $queries[0]->[1]);
+	my $explain = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		EXPLAIN ANALYZE SELECT i FROM tst WHERE $where ORDER BY v <-> '$queries[0]->[0]' LIMIT $limit;
+	));
+	like($explain, qr/Index Cond/);
+
+	for my $i (0 .. $#queries)
+	{
+		my ($query, $c) = @{$queries[$i]};
+		my $where = filter_sql($filter, $c);
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SELECT i FROM tst WHERE $where ORDER BY v <-> '$query' LIMIT $limit;
+		));
+		my @actual_ids = split("\n", $actual);
+		my %actual_set = map { $_ => 1 } @actual_ids;
+		$rows += scalar(@actual_ids);
+
+		my @expected_ids = split("\n", $expected[$i]);
+
+		foreach (@expected_ids)
+		{
+			if (exists($actual_set{$_}))
+			{
+				$correct++;
+			}
+			$total++;
+		}
+	}
+
+	# Should not run out of rows with selective filters
+	is($rows, $total, $filter);
+	cmp_ok($correct / $total, ">=", $min, $filter);
+}
+
+sub get_expected
+{
+	my ($filter) = @_;
+
+	@expected = ();
+	foreach (@queries)
+	{
+		my ($query, $c) = @{$_};
+		my $where = filter_sql($filter, $c);
+		my $res = $node->safe_psql("postgres", qq(
+			SET enable_indexscan = off;
+			SELECT i FROM tst WHERE $where ORDER BY v <-> '$query' LIMIT $limit;
+		));
+		push(@expected, $res);
+	}
+}
+
+# Initialize node
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim), c int4, t text);");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql], i % $nc, 'cat ' || (i % $nc) FROM generate_series(1, 10000) i;"
+);
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, ["[" . join(",", @r) . "]", int(rand() * $nc)]);
+}
+
+# Check build
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops, c, t);");
+
+get_expected("c = CVAL");
+test_recall(0.9, "c = CVAL");
+
+get_expected("t = 'cat CVAL'");
+test_recall(0.9, "t = 'cat CVAL'");
+
+get_expected("c = CVAL AND t = 'cat CVAL'");
+test_recall(0.9, "c = CVAL AND t = 'cat CVAL'");
+
+# Check cross-type operators
+get_expected("c = CVAL::int8");
+test_recall(0.9, "c = CVAL::int8");
+
+# Check inserts
+$node->safe_psql("postgres", "TRUNCATE tst;");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql], i % $nc, 'cat ' || (i % $nc) FROM generate_series(1, 10000) i;"
+);
+
+get_expected("c = CVAL");
+test_recall(0.9, "c = CVAL");
+
+# Check vacuum
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i % 2 = 0;");
+$node->safe_psql("postgres", "VACUUM tst;");
+
+get_expected("c = CVAL");
+test_recall(0.9, "c = CVAL");
+
+done_testing();
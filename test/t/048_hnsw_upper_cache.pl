@@ -0,0 +1,102 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+my @queries = ();
+my $limit = 20;
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+# Create table and index
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) WITH (m = 4);");
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+sub run_queries
+{
+	my ($size) = @_;
+
+	# Use a single session so the cache is reused across queries
+	my $sql = "SET enable_seqscan = off; SET hnsw.upper_cache_size = '$size';";
+	foreach (@queries)
+	{
+		$sql .= "SELECT array_agg(i) FROM (SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit) t;";
+	}
+	return $node->safe_psql("postgres", $sql);
+}
+
+sub test_cache
+{
+	my ($name) = @_;
+	my $expected = run_queries('0');
+
+	# Caching must not change results
+	foreach (('1kB', '64kB', '16MB'))
+	{
+		is(run_queries($_), $expected, "$name $_");
+	}
+}
+
+test_cache("build");
+
+# Check inserts
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(10001, 20000) i;"
+);
+test_cache("insert");
+
+# Check inserts after the cache is built in the same session
+my $query = "SELECT array_agg(i) FROM (SELECT i FROM tst ORDER BY v <-> '[2,2,2]' LIMIT $limit) t;";
+my $expected = $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET hnsw.upper_cache_size = '16MB';
+	$query
+	INSERT INTO tst SELECT i, ARRAY[2 + random() / 100, 2 + random() / 100, 2] FROM generate_series(20001, 21000) i;
+	$query
+));
+my $actual = $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET hnsw.upper_cache_size = '0';
+	$query
+	$query
+));
+is((split("\n", $expected))[1], (split("\n", $actual))[1], "insert same session");
+
+# Check traces include the upper layers
+my $trace = "SELECT layer, tid, distance FROM hnsw_search_trace('idx', '[0.5,0.5,0.5]'::vector) ORDER BY step;";
+$expected = $node->safe_psql("postgres", "SET hnsw.upper_cache_size = '0'; $trace");
+like($expected, qr/^[1-9]/m);
+
+# Run the trace after a query fills the cache
+my @lines = split("\n", $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET hnsw.upper_cache_size = '16MB';
+	$query
+	$trace
+)));
+shift(@lines);
+is(join("\n", @lines), $expected, "trace");
+
+# Check vacuum
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i % 2 = 0;");
+$node->safe_psql("postgres", "VACUUM tst;");
+test_cache("vacuum");
+
+done_testing();
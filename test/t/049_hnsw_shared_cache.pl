@@ -0,0 +1,115 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+my @queries = ();
+my $limit = 20;
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init(allows_streaming => 1);
+$node->append_conf('postgresql.conf', qq(
+shared_preload_libraries = 'vector'
+hnsw.shared_cache_size = '8MB'
+));
+$node->start;
+
+is($node->safe_psql("postgres", "SHOW hnsw.shared_cache_size;"), "8MB");
+
+# Create table and index
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+sub run_queries
+{
+	my @results = ();
+
+	# Use a new session for each query so lists are shared across backends
+	foreach (@queries)
+	{
+		push(@results, $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;
+		)));
+	}
+	return @results;
+}
+
+sub test_cache
+{
+	my ($name) = @_;
+
+	# First run fills the cache and second run reads from it
+	my @cold = run_queries();
+	my @warm = run_queries();
+	is_deeply(\@warm, \@cold, "$name warm");
+
+	# Caching must not change results
+	$node->append_conf('postgresql.conf', "hnsw.shared_cache_size = 0");
+	$node->restart;
+	my @expected = run_queries();
+	is_deeply(\@warm, \@expected, "$name disabled");
+
+	$node->append_conf('postgresql.conf', "hnsw.shared_cache_size = '8MB'");
+	$node->restart;
+}
+
+test_cache("build");
+
+# Check inserts with a warm cache
+run_queries();
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(10001, 20000) i;"
+);
+test_cache("insert");
+
+# Check vacuum with a warm cache
+run_queries();
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i % 2 = 0;");
+$node->safe_psql("postgres", "VACUUM tst;");
+test_cache("vacuum");
+
+# Create streaming replica
+$node->backup('my_backup');
+my $replica = PostgreSQL::Test::Cluster->new('replica');
+$replica->init_from_backup($node, 'my_backup', has_streaming => 1);
+$replica->start;
+
+sub wait_for_replay
+{
+	my $applname = $replica->name;
+	my $caughtup_query = "SELECT pg_current_wal_lsn() <= replay_lsn FROM pg_stat_replication WHERE application_name = '$applname';";
+	$node->poll_query_until('postgres', $caughtup_query)
+	  or die "Timed out while waiting for replica to catch up";
+}
+
+# Scan on the replica before and after inserts on the primary
+my $query = qq(
+	SET enable_seqscan = off;
+	SELECT i FROM tst ORDER BY v <-> '[2,2,2]' LIMIT 10;
+);
+wait_for_replay();
+$replica->safe_psql("postgres", $query);
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[2 + random() / 100, 2, 2] FROM generate_series(30001, 30010) i;"
+);
+wait_for_replay();
+my @actual = sort { $a <=> $b } split("\n", $replica->safe_psql("postgres", $query));
+is_deeply(\@actual, [30001 .. 30010], "replica");
+
+done_testing();
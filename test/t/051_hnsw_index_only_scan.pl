@@ -0,0 +1,91 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node;
+my @queries = ();
+my $dim = 3;
+my $nc = 50;
+my $limit = 20;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub test_index_only
+{
+	my ($where) = @_;
+
+	my $explain = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		EXPLAIN ANALYZE SELECT i, v FROM tst $where ORDER BY v <-> '$queries[0]' LIMIT $limit;
+	));
+	like($explain, qr/Index Only Scan using idx/);
+	like($explain, qr/Heap Fetches: 0/);
+
+	# Same results as an index scan, including the returned vectors
+	for my $query (@queries)
+	{
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SELECT i, v FROM tst $where ORDER BY v <-> '$query' LIMIT $limit;
+		));
+		my $expected = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SET enable_indexonlyscan = off;
+			SELECT i, v FROM tst $where ORDER BY v <-> '$query' LIMIT $limit;
+		));
+		is($actual, $expected);
+	}
+}
+
+# Initialize node
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim), c int4);");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql], i % $nc FROM generate_series(1, 10000) i;"
+);
+
+# Generate queries
+for (1 .. 10)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+# Check build
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) INCLUDE (i);");
+$node->safe_psql("postgres", "VACUUM tst;");
+test_index_only("");
+
+# Check inserts
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql], i % $nc FROM generate_series(10001, 12000) i;"
+);
+$node->safe_psql("postgres", "VACUUM tst;");
+test_index_only("");
+
+# Check vacuum
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i % 2 = 0;");
+$node->safe_psql("postgres", "VACUUM tst;");
+test_index_only("");
+
+# Check filter columns
+$node->safe_psql("postgres", "DROP INDEX idx;");
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops, c) INCLUDE (i);");
+test_index_only("WHERE c = 1");
+
+# Quantized vectors cannot be returned
+$node->safe_psql("postgres", "DROP INDEX idx;");
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) INCLUDE (i) WITH (quantization = 'sq8');");
+my $explain = $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	EXPLAIN SELECT i FROM tst ORDER BY v <-> '$queries[0]' LIMIT $limit;
+));
+like($explain, qr/Index Scan using idx/);
+
+done_testing();
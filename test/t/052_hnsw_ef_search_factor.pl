@@ -0,0 +1,94 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_preload_libraries = 'vector'));
+$node->start;
+
+# Create table and index
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+
+my $settings = qq(
+	SET enable_seqscan = off;
+	SET hnsw.ef_search = 10;
+);
+
+sub count_rows
+{
+	my ($sql) = @_;
+	return $node->safe_psql("postgres", qq(
+		$settings
+		$sql
+	));
+}
+
+# Results are limited by ef_search without a factor
+my $count = count_rows("SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 100) t;");
+is($count, 10);
+
+# Sized from the limit with a factor
+$count = count_rows(qq(
+	SET hnsw.ef_search_factor = 1;
+	SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 100) t;
+));
+is($count, 100);
+
+# Includes the offset
+$count = count_rows(qq(
+	SET hnsw.ef_search_factor = 1;
+	SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 50 OFFSET 50) t;
+));
+is($count, 50);
+
+# Limit is the minimum
+$count = count_rows(qq(
+	SET hnsw.ef_search_factor = 0.5;
+	SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 100) t;
+));
+is($count, 100);
+
+# Replaces ef_search for small limits
+sub count_distances
+{
+	my ($factor) = @_;
+	$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+	$node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET hnsw.ef_search = 200;
+		SET hnsw.ef_search_factor = $factor;
+		SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 5;
+	));
+	return $node->safe_psql("postgres", "SELECT distances FROM pg_stat_vector_indexes WHERE indexrelname = 'idx';");
+}
+cmp_ok(count_distances(2), '<', count_distances(0));
+
+# Limited to the max ef_search
+$count = count_rows(qq(
+	SET hnsw.ef_search_factor = 2;
+	SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 2000) t;
+));
+is($count, 1000);
+
+# Generic plans of prepared statements
+$count = count_rows(qq(
+	SET hnsw.ef_search_factor = 1;
+	SET plan_cache_mode = force_generic_plan;
+	PREPARE p (int8) AS SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT \$1) t;
+	EXECUTE p (200);
+));
+is($count, 200);
+
+done_testing();
@@ -0,0 +1,101 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_preload_libraries = 'vector'));
+$node->start;
+
+# Create tables and indexes
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX hnsw_idx ON tst USING hnsw (v vector_l2_ops);");
+$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+
+sub get_stats
+{
+	my ($index) = @_;
+	return $node->safe_psql("postgres", qq(
+		SELECT distances, pages_read, tuples_visited, resumes, cutoffs, neighbor_updates, lock_waits
+		FROM pg_stat_vector_indexes WHERE indexrelname = '$index';
+	));
+}
+
+# Empty after reset
+is(get_stats('hnsw_idx'), '');
+
+# Check hnsw scans
+$node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET hnsw.iterative_scan = relaxed_order;
+	SET hnsw.max_scan_tuples = 1000;
+	SELECT i FROM tst WHERE i % 100 = 0 ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 20;
+));
+my ($distances, $pages_read, $tuples_visited, $resumes, $cutoffs, $neighbor_updates) = split(/\|/, get_stats('hnsw_idx'));
+cmp_ok($distances, '>', 0);
+cmp_ok($pages_read, '>', 0);
+cmp_ok($tuples_visited, '>', 0);
+cmp_ok($resumes, '>', 0);
+is($cutoffs, 1);
+is($neighbor_updates, 0);
+
+# Check inserts
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 100) i;"
+);
+(undef, undef, undef, undef, undef, $neighbor_updates) = split(/\|/, get_stats('hnsw_idx'));
+cmp_ok($neighbor_updates, '>', 0);
+
+# Check reset
+$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+is(get_stats('hnsw_idx'), '');
+
+# Check scans and inserts in the same statement
+$node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	INSERT INTO tst SELECT i, v FROM tst ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 10;
+));
+($distances, undef, undef, undef, undef, $neighbor_updates) = split(/\|/, get_stats('hnsw_idx'));
+cmp_ok($distances, '>', 0);
+cmp_ok($neighbor_updates, '>', 0);
+
+# Check drop
+my $oid = $node->safe_psql("postgres", "SELECT 'hnsw_idx'::regclass::oid;");
+$node->safe_psql("postgres", "DROP INDEX hnsw_idx;");
+is($node->safe_psql("postgres", "SELECT COUNT(*) FROM pg_stat_vector_indexes() WHERE indexrelid = $oid;"), 0);
+
+# Check ivfflat scans
+$node->safe_psql("postgres", "CREATE INDEX ivfflat_idx ON tst USING ivfflat (v vector_l2_ops) WITH (lists = 10);");
+$node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET ivfflat.probes = 1;
+	SET ivfflat.iterative_scan = relaxed_order;
+	SET ivfflat.max_probes = 2;
+	SELECT i FROM tst WHERE i % 100 = 0 ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 100;
+));
+($distances, $pages_read, $tuples_visited, $resumes, $cutoffs) = split(/\|/, get_stats('ivfflat_idx'));
+cmp_ok($distances, '>', 0);
+cmp_ok($pages_read, '>', 0);
+cmp_ok($tuples_visited, '>', 0);
+is($resumes, 1);
+is($cutoffs, 1);
+
+# Reset requires privileges
+$node->safe_psql("postgres", "CREATE ROLE stats_user;");
+my ($ret, $stdout, $stderr) = $node->psql("postgres", qq(
+	SET ROLE stats_user;
+	SELECT pg_stat_vector_indexes_reset();
+));
+like($stderr, qr/permission denied/);
+
+done_testing();
@@ -0,0 +1,135 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+use Time::HiRes qw(time);
+
+my $node;
+my @queries = ();
+my @expected;
+my $limit = 20;
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub test_recall
+{
+	my ($min) = @_;
+	my $correct = 0;
+	my $total = 0;
+
+	for my $i (0 .. $#queries)
+	{
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SELECT i FROM tst ORDER BY v <-> '$queries[$i]' LIMIT $limit;
+		));
+		my @actual_ids = split("\n", $actual);
+		my %actual_set = map { $_ => 1 } @actual_ids;
+
+		my @expected_ids = split("\n", $expected[$i]);
+
+		foreach (@expected_ids)
+		{
+			if (exists($actual_set{$_}))
+			{
+				$correct++;
+			}
+			$total++;
+		}
+	}
+
+	cmp_ok($correct / $total, ">=", $min);
+}
+
+# Build the index serially and return the pages read and elapsed time
+sub build_index
+{
+	my ($partitioned) = @_;
+
+	$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+	my $start = time();
+	my ($ret, $stdout, $stderr) = $node->psql("postgres", qq(
+		SET hnsw.partitioned_build = $partitioned;
+		SET max_parallel_maintenance_workers = 0;
+		SET maintenance_work_mem = '1MB';
+		CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);
+	));
+	my $elapsed = time() - $start;
+	is($ret, 0, $stderr);
+
+	my $pages_read = $node->safe_psql("postgres",
+		"SELECT pages_read FROM pg_stat_vector_indexes WHERE indexrelname = 'idx';");
+	return ($stderr, $pages_read, $elapsed);
+}
+
+# Initialize node
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_preload_libraries = 'vector'));
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 20000) i;"
+);
+
+# Generate queries
+for (1 .. 20)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+# Get exact results
+foreach (@queries)
+{
+	my $res = $node->safe_psql("postgres", "SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;");
+	push(@expected, $res);
+}
+
+# Build index serially without partitions, inserting on disk once memory is full
+my ($stderr, $fallback_pages_read, $fallback_elapsed) = build_index("off");
+like($stderr, qr/Building will take significantly more time/);
+test_recall(0.95);
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+# Build index serially in partitions
+($stderr, my $pages_read, my $elapsed) = build_index("on");
+like($stderr, qr/Building the graph in partitions/);
+test_recall(0.95);
+
+# Refining partitions should do less work on disk than inserting
+cmp_ok($pages_read, '<', $fallback_pages_read, "pages read");
+note(sprintf("partitioned: %.2fs, %d pages read; on disk: %.2fs, %d pages read",
+	$elapsed, $pages_read, $fallback_elapsed, $fallback_pages_read));
+
+# Check inserts and vacuum after build
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(20001, 20100) i;"
+);
+$node->safe_psql("postgres", "DELETE FROM tst WHERE i > 20000;");
+$node->safe_psql("postgres", "VACUUM tst;");
+test_recall(0.95);
+
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+# Build index in parallel in partitions
+# Set parallel_workers on table to use workers with low maintenance_work_mem
+my ($ret, $stdout);
+($ret, $stdout, $stderr) = $node->psql("postgres", qq(
+	ALTER TABLE tst SET (parallel_workers = 2);
+	SET hnsw.partitioned_build = on;
+	SET client_min_messages = DEBUG;
+	SET maintenance_work_mem = '4MB';
+	CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);
+	ALTER TABLE tst RESET (parallel_workers);
+));
+is($ret, 0, $stderr);
+like($stderr, qr/using \d+ parallel workers/);
+like($stderr, qr/Building the graph in partitions/);
+test_recall(0.95);
+
+done_testing();
@@ -0,0 +1,93 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub test_indexes
+{
+	my ($node, $table, $test_name) = @_;
+
+	my $expected = $node->safe_psql("postgres", qq(
+		SET enable_indexscan = off;
+		SELECT i FROM $table ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 10;
+	));
+
+	# Exact results for ivfflat with all lists probed
+	my $actual = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET ivfflat.probes = 10;
+		SELECT i FROM $table ORDER BY v <=> '[0.5,0.5,0.5]' LIMIT 10;
+	));
+	my $exact = $node->safe_psql("postgres", qq(
+		SET enable_indexscan = off;
+		SELECT i FROM $table ORDER BY v <=> '[0.5,0.5,0.5]' LIMIT 10;
+	));
+	is($actual, $exact, "$test_name: ivfflat");
+
+	# Index must be readable and find the nearest row
+	$actual = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET hnsw.ef_search = 100;
+		SELECT i FROM $table ORDER BY v <-> '[0.5,0.5,0.5]' LIMIT 1;
+	));
+	is($actual, (split("\n", $expected))[0], "$test_name: hnsw");
+}
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+
+# Check logged tables after a crash
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX ON tst USING hnsw (v vector_l2_ops);");
+$node->safe_psql("postgres", "CREATE INDEX ON tst USING ivfflat (v vector_cosine_ops) WITH (lists = 10);");
+$node->stop('immediate');
+$node->start;
+test_indexes($node, 'tst', 'logged');
+
+# Check inserts after build
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(10001, 11000) i;"
+);
+test_indexes($node, 'tst', 'insert');
+
+# Check unlogged tables after a crash
+$node->safe_psql("postgres", "CREATE UNLOGGED TABLE unlogged_tst (i int4, v vector($dim));");
+$node->safe_psql("postgres", "CREATE INDEX ON unlogged_tst USING hnsw (v vector_l2_ops);");
+$node->safe_psql("postgres", "CREATE INDEX ON unlogged_tst USING ivfflat (v vector_cosine_ops) WITH (lists = 10);");
+$node->stop('immediate');
+$node->start;
+$node->safe_psql("postgres",
+	"INSERT INTO unlogged_tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 1000) i;"
+);
+test_indexes($node, 'unlogged_tst', 'unlogged');
+
+# Check builds that skip WAL
+$node->append_conf('postgresql.conf', qq(
+wal_level = minimal
+max_wal_senders = 0
+));
+$node->restart;
+$node->safe_psql("postgres", qq(
+	BEGIN;
+	CREATE TABLE minimal_tst (i int4, v vector($dim));
+	INSERT INTO minimal_tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;
+	CREATE INDEX ON minimal_tst USING hnsw (v vector_l2_ops);
+	CREATE INDEX ON minimal_tst USING ivfflat (v vector_cosine_ops) WITH (lists = 10);
+	COMMIT;
+));
+$node->stop('immediate');
+$node->start;
+test_indexes($node, 'minimal_tst', 'minimal');
+
+done_testing();
@@ -0,0 +1,133 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node;
+my @queries = ();
+my @expected;
+my $limit = 20;
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+
+sub test_recall
+{
+	my ($min) = @_;
+	my $correct = 0;
+	my $total = 0;
+
+	for my $i (0 .. $#queries)
+	{
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SELECT i FROM tst ORDER BY v <-> '$queries[$i]' LIMIT $limit;
+		));
+		my @actual_ids = split("\n", $actual);
+		my %actual_set = map { $_ => 1 } @actual_ids;
+
+		my @expected_ids = split("\n", $expected[$i]);
+
+		foreach (@expected_ids)
+		{
+			if (exists($actual_set{$_}))
+			{
+				$correct++;
+			}
+			$total++;
+		}
+	}
+
+	cmp_ok($correct / $total, ">=", $min);
+}
+
+# Get the average number of blocks read from disk per query
+sub pages_read
+{
+	my $read = 0;
+
+	# Start with an empty cache
+	$node->restart;
+
+	foreach (@queries)
+	{
+		my $plan = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;
+		));
+		$plan =~ /"Shared Read Blocks": (\d+)/ or die "missing buffers";
+		$read += $1;
+	}
+
+	return $read / scalar(@queries);
+}
+
+# Initialize node with a cache much smaller than the index
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_buffers = 256kB));
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 20000) i;"
+);
+
+# Generate queries
+for (1 .. 50)
+{
+	my @r = map { rand() } (1 .. $dim);
+	push(@queries, "[" . join(",", @r) . "]");
+}
+
+# Get exact results
+foreach (@queries)
+{
+	my $res = $node->safe_psql("postgres", "SELECT i FROM tst ORDER BY v <-> '$_' LIMIT $limit;");
+	push(@expected, $res);
+}
+
+# Build index in insertion order
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+my $original = pages_read();
+test_recall(0.99);
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+# Build index in traversal order
+$node->safe_psql("postgres", qq(
+	SET hnsw.reorder_build = on;
+	CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);
+));
+my $reordered = pages_read();
+test_recall(0.99);
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+note("pages read per query: $original original, $reordered reordered");
+cmp_ok($reordered, "<", $original);
+
+# Check graph written before the on-disk phase
+my ($ret, $stdout, $stderr) = $node->psql("postgres", qq(
+	SET hnsw.reorder_build = on;
+	SET max_parallel_maintenance_workers = 0;
+	SET maintenance_work_mem = '1MB';
+	CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);
+));
+is($ret, 0, $stderr);
+like($stderr, qr/hnsw graph no longer fits into maintenance_work_mem/);
+test_recall(0.99);
+$node->safe_psql("postgres", "DROP INDEX idx;");
+
+# Check partitions
+($ret, $stdout, $stderr) = $node->psql("postgres", qq(
+	SET hnsw.reorder_build = on;
+	SET hnsw.partitioned_build = on;
+	SET max_parallel_maintenance_workers = 0;
+	SET maintenance_work_mem = '1MB';
+	CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);
+));
+is($ret, 0, $stderr);
+test_recall(0.95);
+
+done_testing();
@@ -0,0 +1,112 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+my $query = "'[0.5,0.5,0.5]'";
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_preload_libraries = 'vector'));
+$node->start;
+
+# Create table
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 10000) i;"
+);
+
+# Count distances calculated by a scan
+sub get_distances
+{
+	my ($sql) = @_;
+	$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+	my $rows = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET hnsw.iterative_scan = relaxed_order;
+		$sql
+	));
+	my $distances = $node->safe_psql("postgres",
+		"SELECT distances FROM pg_stat_vector_indexes WHERE indexrelname = 'idx';");
+	return ($rows, $distances);
+}
+
+for my $options ("", "WITH (quantization = 'sq8')")
+{
+	$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops) $options;");
+
+	# Order is approximate with sq8, so compare the rows found
+	my $sql = "SELECT i FROM (SELECT i FROM tst WHERE v <-> $query < 0.1 ORDER BY v <-> $query) t ORDER BY i;";
+	my $expected = $node->safe_psql("postgres", qq(
+		SET enable_indexscan = off;
+		$sql
+	));
+
+	# Radius is an index condition
+	my $explain = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		EXPLAIN $sql
+	));
+	like($explain, qr/Index Cond: \(v <@ ROW\(/, "index condition $options");
+
+	my ($rows, $distances) = get_distances($sql);
+	is($rows, $expected, "results $options");
+
+	# Generic plans of prepared statements
+	my ($prepared, $prepared_distances) = get_distances(qq(
+		SET plan_cache_mode = force_generic_plan;
+		PREPARE q(vector, float8) AS SELECT i FROM (SELECT i FROM tst WHERE v <-> \$1 < \$2 ORDER BY v <-> \$1) t ORDER BY i;
+		EXECUTE q($query, 0.1);
+	));
+	is($prepared, $expected, "prepared results $options");
+	is($prepared_distances, $distances, "prepared distances $options");
+
+	# Same condition that does not match the ORDER BY expression
+	my (undef, $unbounded) = get_distances("SELECT i FROM tst WHERE (v <-> $query)::float4 < 0.1 ORDER BY v <-> $query;");
+
+	if ($options eq "")
+	{
+		cmp_ok($distances * 2, '<', $unbounded, "stops early $options");
+	}
+	else
+	{
+		# Approximate distances do not stop the scan
+		is($distances, $unbounded, "does not stop early $options");
+	}
+
+	# Quantized values cannot be returned
+	if ($options eq "")
+	{
+		$node->safe_psql("postgres", "VACUUM tst;");
+
+		my $ios = "SELECT COUNT(*) FROM (SELECT v FROM tst WHERE v <-> $query < 0.1 ORDER BY v <-> $query) t;";
+		$explain = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			EXPLAIN $ios
+		));
+		like($explain, qr/Index Only Scan/, "index-only scan $options");
+
+		my ($count, $ios_distances) = get_distances($ios);
+		my @expected_rows = split("\n", $expected);
+		is($count, scalar(@expected_rows), "index-only scan results $options");
+		is($ios_distances, $distances, "index-only scan distances $options");
+	}
+
+	# Radius does not apply to other statements in the session
+	my $count = $node->safe_psql("postgres", qq(
+		SET enable_seqscan = off;
+		SET hnsw.iterative_scan = relaxed_order;
+		SELECT COUNT(*) FROM (SELECT i FROM tst WHERE v <-> $query < 0.1 ORDER BY v <-> $query LIMIT 1) t;
+		SELECT COUNT(*) FROM (SELECT i FROM tst ORDER BY v <-> $query LIMIT 100) t;
+	));
+	is($count, "1\n100", "scoped to scan $options");
+
+	$node->safe_psql("postgres", "DROP INDEX idx;");
+}
+
+done_testing();
@@ -0,0 +1,133 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node;
+my @queries = ();
+my @expected;
+my $limit = 20;
+
+sub get_recall
+{
+	my ($operator) = @_;
+	my $correct = 0;
+	my $total = 0;
+
+	for my $i (0 .. $#queries)
+	{
+		my $actual = $node->safe_psql("postgres", qq(
+			SET enable_seqscan = off;
+			SET hnsw.ef_search = 100;
+			SELECT i FROM tst ORDER BY v $operator '$queries[$i]' LIMIT $limit;
+		));
+		my @actual_ids = split("\n", $actual);
+		my %actual_set = map { $_ => 1 } @actual_ids;
+
+		my @expected_ids = split("\n", $expected[$i]);
+
+		foreach (@expected_ids)
+		{
+			if (exists($actual_set{$_}))
+			{
+				$correct++;
+			}
+			$total++;
+		}
+	}
+
+	return $correct / $total;
+}
+
+# Build index serially in memory and get recall
+sub build_recall
+{
+	my ($operator, $opclass, $m) = @_;
+
+	$node->safe_psql("postgres", qq(
+		SET max_parallel_maintenance_workers = 0;
+		CREATE INDEX idx ON tst USING hnsw (v $opclass) WITH (m = $m);
+	));
+
+	my $recall = get_recall($operator);
+
+	$node->safe_psql("postgres", "DROP INDEX idx;");
+
+	return $recall;
+}
+
+# Initialize node
+$node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->start;
+
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+
+# Distance functions without batch kernels use one call per pair
+$node->safe_psql("postgres", qq(
+	CREATE OPERATOR CLASS test_l2_ops
+		FOR TYPE vector USING hnsw AS
+		OPERATOR 1 <-> (vector, vector) FOR ORDER BY float_ops,
+		FUNCTION 1 l2_distance(vector, vector);
+	CREATE OPERATOR CLASS test_cosine_ops
+		FOR TYPE vector USING hnsw AS
+		OPERATOR 1 <=> (vector, vector) FOR ORDER BY float_ops,
+		FUNCTION 1 cosine_distance(vector, vector);
+));
+
+my @operators = ("<->", "<#>", "<=>", "<+>");
+my @opclasses = ("vector_l2_ops", "vector_ip_ops", "vector_cosine_ops", "vector_l1_ops");
+my %fallbacks = ("<->" => "test_l2_ops", "<=>" => "test_cosine_ops");
+
+# Dimensions that are not a multiple of the vector width
+for my $dim (3, 5, 7)
+{
+	my $array_sql = join(",", ('random() * random()') x $dim);
+
+	$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+	$node->safe_psql("postgres",
+		"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 5000) i;"
+	);
+
+	# Generate queries
+	@queries = ();
+	for (1 .. 20)
+	{
+		my @r = map { rand() } (1 .. $dim);
+		push(@queries, "[" . join(",", @r) . "]");
+	}
+
+	for my $i (0 .. $#operators)
+	{
+		my $operator = $operators[$i];
+		my $opclass = $opclasses[$i];
+
+		# Get exact results
+		@expected = ();
+		foreach (@queries)
+		{
+			my $res = $node->safe_psql("postgres", "SELECT i FROM tst ORDER BY v $operator '$_' LIMIT $limit;");
+			push(@expected, $res);
+		}
+
+		# Small m prunes fewer neighbors than a batch of four
+		for my $m (3, 16)
+		{
+			my $min = $operator eq "<#>" ? 0.9 : 0.95;
+			my $recall = build_recall($operator, $opclass, $m);
+			cmp_ok($recall, ">=", $min, "$opclass dim $dim m $m");
+
+			# Compare with the same distances calculated one pair at a time
+			if (exists($fallbacks{$operator}))
+			{
+				my $fallback_recall = build_recall($operator, $fallbacks{$operator}, $m);
+				cmp_ok(abs($recall - $fallback_recall), "<=", 0.03, "$opclass dim $dim m $m matches $fallbacks{$operator}");
+			}
+		}
+	}
+
+	$node->safe_psql("postgres", "DROP TABLE tst;");
+}
+
+done_testing();
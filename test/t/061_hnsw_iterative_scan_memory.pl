@@ -0,0 +1,101 @@
+use strict;
+use warnings FATAL => 'all';
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $dim = 3;
+my $array_sql = join(",", ('random()') x $dim);
+my $query = "'[0.5,0.5,0.5]'";
+
+# Initialize node
+my $node = PostgreSQL::Test::Cluster->new('node');
+$node->init;
+$node->append_conf('postgresql.conf', qq(shared_preload_libraries = 'vector'));
+$node->start;
+
+# Create table and index
+$node->safe_psql("postgres", "CREATE EXTENSION vector;");
+$node->safe_psql("postgres", "CREATE TABLE tst (i int4, v vector($dim));");
+$node->safe_psql("postgres",
+	"INSERT INTO tst SELECT i, ARRAY[$array_sql] FROM generate_series(1, 50000) i;"
+);
+$node->safe_psql("postgres", "CREATE INDEX idx ON tst USING hnsw (v vector_l2_ops);");
+
+# Scan until the memory limit with a filter that matches no rows
+$node->safe_psql("postgres", "SELECT pg_stat_vector_indexes_reset();");
+my $count = $node->safe_psql("postgres", qq(
+	SET enable_seqscan = off;
+	SET work_mem = '2MB';
+	SET hnsw.scan_mem_multiplier = 1;
+	SET hnsw.max_scan_tuples = 1000000;
+	SET hnsw.iterative_scan = relaxed_order;
+	SELECT COUNT(*) FROM (SELECT i FROM tst WHERE i < 0 ORDER BY v <-> $query LIMIT 10) t;
+));
+is($count, 0);
+
+my ($tuples_visited, $cutoffs) = split(/\|/, $node->safe_psql("postgres",
+	"SELECT tuples_visited, cutoffs FROM pg_stat_vector_indexes WHERE indexrelname = 'idx';"));
+is($cutoffs, 1);
+
+# Discarded tuples used to keep a loaded element and a candidate (about 220 bytes)
+my $baseline = 2 * 1024 * 1024 / 220;
+cmp_ok($tuples_visited, '>', $baseline);
+
+# Check elements deleted and replaced after a scan discards them
+SKIP:
+{
+	skip("background psql requires PostgreSQL 16+", 3) if $node->pg_version < 16;
+
+	$node->safe_psql("postgres", "CREATE TABLE tst2 (i int4, v vector($dim));");
+	$node->safe_psql("postgres",
+		"INSERT INTO tst2 SELECT i, ARRAY[$array_sql] FROM generate_series(1, 2000) i;"
+	);
+	$node->safe_psql("postgres", "CREATE INDEX idx2 ON tst2 USING hnsw (v vector_l2_ops);");
+
+	# Rows from aborted transactions can be vacuumed while the scan is open
+	$node->safe_psql("postgres", qq(
+		BEGIN;
+		INSERT INTO tst2 SELECT -i, ARRAY[$array_sql] FROM generate_series(1, 2000) i;
+		ROLLBACK;
+	));
+
+	my $psql = $node->background_psql("postgres");
+	$psql->query_safe(qq(
+		SET enable_seqscan = off;
+		SET hnsw.ef_search = 10;
+		SET hnsw.max_scan_tuples = 1000000;
+		SET hnsw.iterative_scan = relaxed_order;
+		BEGIN;
+		DECLARE c CURSOR FOR SELECT i FROM tst2 ORDER BY v <-> $query;
+	));
+	my $first = $psql->query_safe("FETCH 20 FROM c;");
+
+	# Delete the elements, and reuse their tuples for new rows
+	$node->safe_psql("postgres", "VACUUM tst2;");
+	$node->safe_psql("postgres",
+		"INSERT INTO tst2 SELECT i, ARRAY[$array_sql] FROM generate_series(2001, 4000) i;"
+	);
+
+	my $rest = $psql->query_safe("FETCH ALL FROM c;");
+	$psql->query_safe("COMMIT;");
+	$psql->quit;
+
+	my @ids = split("\n", $first . "\n" . $rest);
+	my %seen = ();
+	my $duplicates = 0;
+	my $invalid = 0;
+	foreach (@ids)
+	{
+		$duplicates++ if exists($seen{$_});
+		$invalid++ if $_ < 1 || $_ > 2000;
+		$seen{$_} = 1;
+	}
+
+	# Only rows visible to the scan, once each
+	is($duplicates, 0);
+	is($invalid, 0);
+	cmp_ok(scalar(@ids), '>', 1000);
+}
+
+done_testing();